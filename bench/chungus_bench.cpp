@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "globals.hpp"
+
+#include "application.hpp"
+
+#ifndef CHUNGUS_BUILD_TYPE
+#define CHUNGUS_BUILD_TYPE "unknown"
+#endif
+
+namespace {
+
+struct resolution_t {
+  uint32_t width = 0, height = 0;
+};
+
+struct bench_options_t {
+  std::vector<resolution_t> resolutions = {{800, 600}};
+  std::vector<uint32_t> instance_counts = {1};
+  std::vector<uint32_t> draw_counts = {1};
+  uint64_t frames = 1000, warmup = 100;
+  uint32_t worker_threads = 0; // 0 picks from cores
+  uint32_t frames_in_flight = 2;
+  bool async_queues = true;
+  bool gpu_culling = true;
+  float zoom = 1.0f;
+
+  bool headless = true, readback = false;
+  readback_layout_t readback_layout = readback_layout_t::rgba8;
+  uint32_t readback_scale = 1;
+  std::string_view device_name = {};
+  std::string_view mesh_path = {};           // triangle when empty
+  std::string_view pipeline_cache_path = {}; // cold pipeline builds when empty
+  std::string_view json_path = "-";
+};
+
+struct bench_result_t {
+  resolution_t resolution = {};
+  uint32_t instances = 0;
+  uint32_t draws = 0;
+  uint64_t readback_frames = 0;
+  uint64_t readback_bytes = 0; // host visible bytes read by the callback
+
+  std::string device = {};
+  startup_timings_t startup = {};
+  frame_timings_t frames = {};
+};
+
+template <typename T> bool parse_number(const std::string_view value, T &out) {
+  const auto [end, error] =
+      std::from_chars(value.data(), value.data() + value.size(), out);
+  return error == std::errc{} && end == value.data() + value.size();
+}
+
+// comma separated list, eg: 800x600,1920x1080
+bool parse_resolutions(std::string_view value,
+                       std::vector<resolution_t> &resolutions) {
+  resolutions.clear();
+  while (!value.empty()) {
+    const auto entry = value.substr(0, value.find(','));
+    value.remove_prefix(std::min(value.size(), entry.size() + 1));
+
+    const auto split = entry.find('x');
+    if (split == std::string_view::npos)
+      return false;
+
+    resolution_t resolution = {};
+    if (!parse_number(entry.substr(0, split), resolution.width) ||
+        !parse_number(entry.substr(split + 1), resolution.height) ||
+        resolution.width == 0 || resolution.height == 0)
+      return false;
+
+    resolutions.push_back(resolution);
+  }
+
+  return !resolutions.empty();
+}
+
+// comma separated list, eg: 1,1000,100000
+bool parse_counts(std::string_view value, std::vector<uint32_t> &counts) {
+  counts.clear();
+  while (!value.empty()) {
+    const auto entry = value.substr(0, value.find(','));
+    value.remove_prefix(std::min(value.size(), entry.size() + 1));
+
+    uint32_t count = 0;
+    if (!parse_number(entry, count) || count == 0)
+      return false;
+
+    counts.push_back(count);
+  }
+
+  return !counts.empty();
+}
+
+bench_result_t run(const bench_options_t &options,
+                   const resolution_t resolution, const uint32_t instances,
+                   const uint32_t draws) {
+  bench_result_t result = {};
+  result.resolution = resolution;
+  result.instances = instances;
+  result.draws = draws;
+
+  chungus_config_t config = {};
+  config.width = resolution.width;
+  config.height = resolution.height;
+  config.title = "chungus_bench";
+  config.headless = options.headless;
+  config.device_name = options.device_name;
+  config.mesh_path = options.mesh_path;
+  config.pipeline_cache_path = options.pipeline_cache_path;
+  config.frame_count = options.warmup + options.frames;
+  config.warmup_frames = options.warmup;
+  config.instance_count = instances;
+  config.draws_per_frame = draws;
+  config.worker_threads = options.worker_threads;
+  config.frames_in_flight = options.frames_in_flight;
+  config.async_queues = options.async_queues;
+  config.gpu_culling = options.gpu_culling;
+  config.zoom = options.zoom;
+  config.pacing = pacing_mode_t::uncapped;
+
+  config.readback_layout = options.readback_layout;
+  config.readback_scale = options.readback_scale;
+  if (options.readback)
+    config.readback_callback = [&](const readback_frame_t &frame) {
+      result.readback_frames += 1;
+      result.readback_bytes += frame.data.size();
+    };
+
+  const chungus_application app{config};
+  result.device = app.device();
+  result.startup = app.startup();
+  result.frames = app.timings();
+  return result;
+}
+
+// quoted json string, paths and device names may hold quotes, backslashes
+// or control characters
+void write_string(std::ostream &stream, const std::string_view value) {
+  constexpr char hex[] = "0123456789abcdef";
+
+  stream << '"';
+  for (const auto c : value) {
+    const auto byte = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\')
+      stream << '\\' << c;
+    else if (byte < 0x20)
+      stream << "\\u00" << hex[byte >> 4] << hex[byte & 0xf];
+    else
+      stream << c;
+  }
+  stream << '"';
+}
+
+void write_summary(std::ostream &stream,
+                   const rolling_histogram_t::summary_t &summary,
+                   const double mean) {
+  stream << "{\"mean\": " << mean << ", \"p50\": " << summary.p50
+         << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+         << "}";
+}
+
+void write_json(std::ostream &stream, const bench_options_t &options,
+                const std::vector<bench_result_t> &results) {
+  stream << std::fixed << std::setprecision(4);
+  stream << "{\n";
+  stream << "  \"build_type\": \"" << CHUNGUS_BUILD_TYPE << "\",\n";
+  stream << "  \"headless\": " << (options.headless ? "true" : "false")
+         << ",\n";
+  stream << "  \"readback\": " << (options.readback ? "true" : "false")
+         << ",\n";
+  stream << "  \"readback_layout\": \""
+         << readback_layout_names[static_cast<size_t>(options.readback_layout)]
+         << "\",\n";
+  stream << "  \"readback_scale\": " << options.readback_scale << ",\n";
+  stream << "  \"pipeline_cache\": "
+         << (options.pipeline_cache_path.empty() ? "false" : "true") << ",\n";
+  stream << "  \"worker_threads\": " << options.worker_threads << ",\n";
+  stream << "  \"frames_in_flight\": " << options.frames_in_flight << ",\n";
+  stream << "  \"async_queues\": "
+         << (options.async_queues ? "true" : "false") << ",\n";
+  stream << "  \"gpu_culling\": "
+         << (options.gpu_culling ? "true" : "false") << ",\n";
+  stream << "  \"zoom\": " << options.zoom << ",\n";
+  stream << "  \"mesh\": ";
+  write_string(stream, options.mesh_path);
+  stream << ",\n";
+  stream << "  \"frames\": " << options.frames << ",\n";
+  stream << "  \"warmup\": " << options.warmup << ",\n";
+  stream << "  \"runs\": [";
+
+  for (size_t index = 0; index < results.size(); index += 1) {
+    const auto &result = results[index];
+    const auto frame_ms = result.frames.mean(frame_stage_t::frame);
+
+    stream << (index == 0 ? "\n" : ",\n") << "    {\n";
+    stream << "      \"device\": ";
+    write_string(stream, result.device);
+    stream << ",\n";
+    stream << "      \"width\": " << result.resolution.width << ",\n";
+    stream << "      \"height\": " << result.resolution.height << ",\n";
+    stream << "      \"instances\": " << result.instances << ",\n";
+    stream << "      \"draws\": " << result.draws << ",\n";
+    stream << "      \"readback_frames\": " << result.readback_frames
+           << ",\n";
+    stream << "      \"readback_bytes\": " << result.readback_bytes << ",\n";
+
+    stream << "      \"startup_ms\": {";
+    for (size_t phase = 0; phase < startup_phase_names.size(); phase += 1)
+      stream << "\"" << startup_phase_names[phase] << "\": "
+             << result.startup.milliseconds(
+                    static_cast<startup_phase_t>(phase))
+             << ", ";
+    stream << "\"total\": " << result.startup.total() << "},\n";
+
+    stream << "      \"fps\": " << (frame_ms > 0 ? 1000.0 / frame_ms : 0.0)
+           << ",\n";
+    stream << "      \"ms_per_frame\": " << frame_ms << ",\n";
+
+    stream << "      \"stages_ms\": {";
+    for (size_t stage = 0; stage < frame_stage_names.size(); stage += 1) {
+      const auto id = static_cast<frame_stage_t>(stage);
+      stream << (stage == 0 ? "\n" : ",\n") << "        \""
+             << frame_stage_names[stage] << "\": ";
+      write_summary(stream, result.frames.summary(id), result.frames.mean(id));
+    }
+    stream << "\n      }\n";
+    stream << "    }";
+  }
+
+  stream << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bench_options_t options = {};
+
+  for (int index = 1; index < argc; index += 1) {
+    const std::string_view arg{argv[index]};
+    const std::string_view value = index + 1 < argc ? argv[index + 1] : "";
+
+    if (arg == "--windowed") {
+      options.headless = false;
+    } else if (arg == "--readback") {
+      options.readback = true;
+    } else if (arg == "--readback-layout" &&
+               parse_readback_layout(value, options.readback_layout)) {
+      index += 1;
+    } else if (arg == "--readback-scale" &&
+               parse_number(value, options.readback_scale) &&
+               options.readback_scale > 0) {
+      index += 1;
+    } else if (arg == "--frames" && parse_number(value, options.frames) &&
+               options.frames > 0) {
+      index += 1;
+    } else if (arg == "--warmup" && parse_number(value, options.warmup)) {
+      index += 1;
+    } else if (arg == "--resolutions" &&
+               parse_resolutions(value, options.resolutions)) {
+      index += 1;
+    } else if (arg == "--instances" &&
+               parse_counts(value, options.instance_counts)) {
+      index += 1;
+    } else if (arg == "--draws" && parse_counts(value, options.draw_counts)) {
+      index += 1;
+    } else if (arg == "--worker-threads" &&
+               parse_number(value, options.worker_threads)) {
+      index += 1;
+    } else if (arg == "--frames-in-flight" &&
+               parse_number(value, options.frames_in_flight) &&
+               options.frames_in_flight > 0) {
+      index += 1;
+    } else if (arg == "--no-gpu-culling") {
+      options.gpu_culling = false;
+    } else if (arg == "--zoom" && parse_number(value, options.zoom) &&
+               options.zoom > 0.0f) {
+      index += 1;
+    } else if (arg == "--no-async-queues") {
+      options.async_queues = false;
+    } else if (arg == "--stress") {
+      // one draw against many for the same instance totals
+      options.instance_counts = {1000, 10000, 100000, 1000000};
+      options.draw_counts = {1, 100, 10000};
+    } else if (arg == "--device" && !value.empty()) {
+      options.device_name = value;
+      index += 1;
+    } else if (arg == "--mesh" && !value.empty()) {
+      options.mesh_path = value;
+      index += 1;
+    } else if (arg == "--pipeline-cache" && !value.empty()) {
+      options.pipeline_cache_path = value;
+      index += 1;
+    } else if (arg == "--json" && !value.empty()) {
+      options.json_path = value;
+      index += 1;
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--frames n] [--warmup n]"
+                   " [--resolutions WxH,...] [--instances n,...]"
+                   " [--draws n,...] [--stress] [--worker-threads n]"
+                   " [--frames-in-flight n] [--no-async-queues]"
+                   " [--no-gpu-culling] [--zoom f] [--mesh file.cmesh]"
+                   " [--windowed] [--readback] [--device name]"
+                   " [--readback-layout rgba8|rgb8|yuv420]"
+                   " [--readback-scale n]"
+                   " [--pipeline-cache path] [--json path|-]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // keep stdout clean for the json report, the renderer logs to cout
+  auto *const stdout_buffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+  std::vector<bench_result_t> results = {};
+  for (const auto resolution : options.resolutions) {
+    for (const auto instances : options.instance_counts) {
+      for (const auto draws : options.draw_counts) {
+        if (draws > instances)
+          continue;
+
+        std::cerr << "bench: " << resolution.width << "x" << resolution.height
+                  << ", " << instances << " instances, " << draws << " draws"
+                  << std::endl;
+
+        results.push_back(run(options, resolution, instances, draws));
+        results.back().frames.print(std::cerr);
+      }
+    }
+  }
+
+  std::cout.rdbuf(stdout_buffer);
+
+  if (options.json_path == "-") {
+    write_json(std::cout, options, results);
+  } else {
+    std::ofstream output{std::string{options.json_path}};
+    if (!output.is_open()) {
+      std::cerr << "failed to open " << options.json_path << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    write_json(output, options, results);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,13 +1,29 @@
+#include <algorithm>
 #include <array>
 #include <chrono>
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <span>
 #include <thread>
+#include <utility>
 
 #include "globals.hpp"
 
 #include "application.hpp"
+#include "command_recorder.hpp"
+#include "culling.hpp"
+#include "frame_resources.hpp"
+#include "frame_scheduler.hpp"
+#include "instances.hpp"
+#include "job_system.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_manager.hpp"
+#include "pipeline_state.hpp"
+#include "queues.hpp"
+#include "shader_registry.hpp"
 
 auto chungus_application::gflw_window_deleter::operator()(GLFWwindow *window) {
   glfwDestroyWindow(window);
@@ -26,22 +42,62 @@ auto chungus_application::create_glfw_window(const uint32_t width,
   return new_window;
 }
 
-auto chungus_application::create_vulkan_instance(const std::string_view title) {
+auto chungus_application::validation_supported() {
+  uint32_t layer_count = 0;
+  VK_CALL(vkEnumerateInstanceLayerProperties(&layer_count, nullptr));
 
-  VkInstance instance = {};
+  std::vector<VkLayerProperties> layers{layer_count};
+  VK_CALL(vkEnumerateInstanceLayerProperties(&layer_count, layers.data()));
 
-  {
-    std::vector<const char *> extensions = {
-        VK_KHR_SURFACE_EXTENSION_NAME,
-        VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME,
-    };
+  // render nodes usually ship only the icd, not the sdk layers
+  for (const auto *name : validation_layers) {
+    const auto found =
+        std::any_of(layers.begin(), layers.end(), [&](const auto &layer) {
+          return std::string_view{layer.layerName} == name;
+        });
+
+    if (!found)
+      return false;
+  }
 
-    uint32_t glfw_extension_count = 0;
-    auto **glfw_extensions_ptr =
-        glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+  return true;
+}
 
-    extensions.insert(extensions.end(), glfw_extensions_ptr,
-                      glfw_extensions_ptr + glfw_extension_count);
+auto chungus_application::create_vulkan_instance(const std::string_view title,
+                                                 const bool headless) {
+
+  VkInstance instance = {};
+
+  {
+    uint32_t extension_count = 0;
+    VK_CALL(vkEnumerateInstanceExtensionProperties(nullptr, &extension_count,
+                                                   nullptr));
+
+    std::vector<VkExtensionProperties> available{extension_count};
+    VK_CALL(vkEnumerateInstanceExtensionProperties(nullptr, &extension_count,
+                                                   available.data()));
+
+    const auto portability_enumeration = std::any_of(
+        available.begin(), available.end(), [](const auto &extension) {
+          return std::string_view{extension.extensionName} ==
+                 VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME;
+        });
+
+    std::vector<const char *> extensions = {};
+    if (portability_enumeration)
+      extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+
+    // headless rendering needs no surface extensions
+    if (!headless) {
+      extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+
+      uint32_t glfw_extension_count = 0;
+      auto **glfw_extensions_ptr =
+          glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+
+      extensions.insert(extensions.end(), glfw_extensions_ptr,
+                        glfw_extensions_ptr + glfw_extension_count);
+    }
 
     VkApplicationInfo app_info = {};
     app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -50,11 +106,14 @@ auto chungus_application::create_vulkan_instance(const std::string_view title) {
     app_info.pEngineName = "RAW";
     app_info.apiVersion = VK_API_VERSION_1_3;
 
+    const auto validation = validation_supported();
+
     VkInstanceCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    create_info.flags = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+    if (portability_enumeration)
+      create_info.flags = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
     create_info.pApplicationInfo = &app_info;
-    create_info.enabledLayerCount = validation_layers.size();
+    create_info.enabledLayerCount = validation ? validation_layers.size() : 0;
     create_info.ppEnabledLayerNames = validation_layers.data();
     create_info.enabledExtensionCount = extensions.size();
     create_info.ppEnabledExtensionNames = extensions.data();
@@ -66,44 +125,23 @@ auto chungus_application::create_vulkan_instance(const std::string_view title) {
   return instance;
 }
 
-auto chungus_application::create_default_shaders() {
-  std::ifstream vertex_input{"shaders/default.vert.spv",
-                             std::ios::ate | std::ios::binary};
-  ASSERT(vertex_input.is_open());
-  uint32_t vertex_file_size = vertex_input.tellg();
-  ASSERT(vertex_file_size % sizeof(uint32_t) == 0);
+chungus_application::chungus_application(const chungus_config_t &config)
+    : config(config) {
+  startup_timings.restart();
 
-  std::ifstream fragment_input{"shaders/default.frag.spv",
-                               std::ios::ate | std::ios::binary};
-  ASSERT(fragment_input.is_open());
-  uint32_t fragment_file_size = fragment_input.tellg();
-  ASSERT(fragment_file_size % sizeof(uint32_t) == 0);
+  // the render thread takes part in every wait, one worker per other core
+  jobs = std::make_unique<job_system_t>(
+      config.worker_threads != 0
+          ? config.worker_threads
+          : std::max(std::thread::hardware_concurrency(), 2u) - 1);
 
-  std::vector<char> vertex_shader(vertex_file_size / sizeof(char));
-  {
-    vertex_input.seekg(0);
-    vertex_input.read(vertex_shader.data(), vertex_file_size);
-    vertex_input.close();
-  }
-
-  std::vector<char> fragment_shader(fragment_file_size / sizeof(char));
-  {
-    fragment_input.seekg(0);
-    fragment_input.read(fragment_shader.data(), fragment_file_size);
-    fragment_input.close();
+  if (!config.headless) {
+    GLFW_CALL(glfwInit());
+    window.reset(create_glfw_window(config.width, config.height, config.title));
   }
 
-  return std::make_tuple(std::move(vertex_shader), std::move(fragment_shader));
-}
-
-chungus_application::chungus_application(const uint32_t height,
-                                         const uint32_t width,
-                                         const std::string_view title)
-    : window_height(height), window_width(width), window_title(title) {
-  GLFW_CALL(glfwInit());
-
-  window.reset(create_glfw_window(window_width, window_height, window_title));
-  instance = create_vulkan_instance(window_title);
+  instance = create_vulkan_instance(config.title, config.headless);
+  startup_timings.mark(startup_phase_t::instance);
 
   render_info = {};
 
@@ -112,15 +150,20 @@ chungus_application::chungus_application(const uint32_t height,
   cleanup_graphics();
 }
 
-chungus_application::~chungus_application() { glfwTerminate(); }
+chungus_application::~chungus_application() {
+  if (!config.headless)
+    glfwTerminate();
+}
 
 void chungus_application::initialize_graphics() {
-  // get surface
-  VkSurfaceKHR surface = {};
-  VK_CALL(glfwCreateWindowSurface(instance, window.get(), nullptr, &surface));
+  // get surface, none when rendering headless
+  if (!config.headless)
+    VK_CALL(glfwCreateWindowSurface(instance, window.get(), nullptr,
+                                    &render_info.surface));
 
   // get physical device
   VkPhysicalDevice physical_device = {};
+  VkPhysicalDeviceProperties device_properties = {};
   {
     uint32_t device_count = 0;
     VK_CALL(vkEnumeratePhysicalDevices(instance, &device_count, nullptr));
@@ -130,51 +173,56 @@ void chungus_application::initialize_graphics() {
     VK_CALL(
         vkEnumeratePhysicalDevices(instance, &device_count, devices.data()));
 
+    if (config.device_name.empty())
+      physical_device = devices[0];
+
     for (const auto &device : devices) {
       VkPhysicalDeviceProperties properties = {};
       vkGetPhysicalDeviceProperties(device, &properties);
       std::cout << "physical device: " << properties.deviceName << std::endl;
-    }
 
-    physical_device = devices[0];
-  }
+      // pick a specific device, eg: the lavapipe software icd
+      const std::string_view device_name{properties.deviceName};
+      if (!config.device_name.empty() &&
+          device_name.find(config.device_name) != std::string_view::npos)
+        physical_device = device;
+    }
 
-  // get grpahics queue index
-  uint32_t graphics_queue_family_index = -1;
-  {
-    uint32_t queue_family_count = 0;
-    vkGetPhysicalDeviceQueueFamilyProperties(physical_device,
-                                             &queue_family_count, nullptr);
-
-    std::vector<VkQueueFamilyProperties> queue_families{queue_family_count};
-    vkGetPhysicalDeviceQueueFamilyProperties(
-        physical_device, &queue_family_count, queue_families.data());
-
-    for (int index = 0; index < queue_families.size(); index += 1) {
-      if (queue_families[index].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-        VkBool32 present_support = {};
-        VK_CALL(vkGetPhysicalDeviceSurfaceSupportKHR(
-            physical_device, index, surface, &present_support));
-
-        if (present_support) {
-          graphics_queue_family_index = 0;
-          break;
-        }
-      }
+    // a run meant for one device must not quietly measure another
+    if (physical_device == VK_NULL_HANDLE) {
+      std::cerr << "physical device: none matches \"" << config.device_name
+                << "\"" << std::endl;
+      std::exit(EXIT_FAILURE);
     }
 
-    ASSERT(graphics_queue_family_index != -1);
+    vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+    device_name = device_properties.deviceName;
   }
 
+  // get queue families, compute and transfer share the graphics queue when
+  // there is no dedicated family, eg: lavapipe
+  render_info.queue_families =
+      find_queue_families(physical_device, render_info.surface,
+                          config.async_queues);
+  const auto graphics_queue_family_index = render_info.queue_families.graphics;
+  const auto timestamp_valid_bits =
+      render_info.queue_families.timestamp_valid_bits;
+
+  std::cout << "queue families: graphics "
+            << render_info.queue_families.graphics << ", compute "
+            << render_info.queue_families.compute << ", transfer "
+            << render_info.queue_families.transfer << std::endl;
+
   // get the right surface format supported by physical device
-  VkSurfaceFormatKHR surface_format = {};
-  {
+  VkSurfaceFormatKHR surface_format = {VK_FORMAT_B8G8R8A8_SRGB,
+                                       VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+  if (!config.headless) {
     uint32_t format_count = 0;
-    VK_CALL(vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface,
-                                                 &format_count, nullptr));
+    VK_CALL(vkGetPhysicalDeviceSurfaceFormatsKHR(
+        physical_device, render_info.surface, &format_count, nullptr));
 
     std::vector<VkSurfaceFormatKHR> surface_formats{format_count};
-    vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface,
+    vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, render_info.surface,
                                          &format_count, surface_formats.data());
 
     for (const auto &entry : surface_formats) {
@@ -187,45 +235,201 @@ void chungus_application::initialize_graphics() {
   }
 
   VkSurfaceCapabilitiesKHR device_capabilities = {};
-  VK_CALL(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface,
-                                                    &device_capabilities));
+  if (!config.headless)
+    VK_CALL(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+        physical_device, render_info.surface, &device_capabilities));
+
+  // gpu culling draws through vkCmdDrawIndexedIndirectCount, with several
+  // commands per call and a non zero firstInstance
+  bool gpu_culling = config.gpu_culling;
+
+  // bindless textures index a partially bound sampler array, updated after
+  // it is bound, non uniformly, none of which vulkan 1.3 requires
+  bool bindless = false;
+  {
+    VkPhysicalDeviceVulkan12Features features_12 = {};
+    features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features_12;
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+
+    gpu_culling = gpu_culling && features_12.drawIndirectCount &&
+                  features.features.multiDrawIndirect &&
+                  features.features.drawIndirectFirstInstance;
+
+    if (config.gpu_culling && !gpu_culling)
+      std::cout << "gpu culling: not supported, drawing on the cpu"
+                << std::endl;
+
+    bindless = features_12.descriptorIndexing &&
+               features_12.runtimeDescriptorArray &&
+               features_12.shaderSampledImageArrayNonUniformIndexing &&
+               features_12.descriptorBindingPartiallyBound &&
+               features_12.descriptorBindingSampledImageUpdateAfterBind;
+
+    if (!bindless)
+      std::cout << "textures: not supported, drawing untextured" << std::endl;
+  }
 
   // get logical vulkan device
   {
     const auto queue_priority = 1.0f;
 
-    std::vector<VkDeviceQueueCreateInfo> queue_create_infos = {{
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = graphics_queue_family_index,
-        .queueCount = 1,
-        .pQueuePriorities = &queue_priority,
-    }};
+    // one queue per distinct family
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos = {};
+    for (const auto family : {render_info.queue_families.graphics,
+                              render_info.queue_families.compute,
+                              render_info.queue_families.transfer}) {
+      if (std::any_of(queue_create_infos.begin(), queue_create_infos.end(),
+                      [&](const auto &info) {
+                        return info.queueFamilyIndex == family;
+                      }))
+        continue;
+
+      queue_create_infos.push_back({
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .queueFamilyIndex = family,
+          .queueCount = 1,
+          .pQueuePriorities = &queue_priority,
+      });
+    }
+
+    std::vector<const char *> extensions = {};
+    {
+      if (!config.headless)
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+      uint32_t extension_count = 0;
+      VK_CALL(vkEnumerateDeviceExtensionProperties(
+          physical_device, nullptr, &extension_count, nullptr));
+
+      std::vector<VkExtensionProperties> available{extension_count};
+      VK_CALL(vkEnumerateDeviceExtensionProperties(
+          physical_device, nullptr, &extension_count, available.data()));
+
+      // must be enabled when advertised, eg: moltenvk
+      for (const auto &extension : available)
+        if (std::string_view{extension.extensionName} ==
+            portability_subset_extension)
+          extensions.push_back(portability_subset_extension);
+    }
+
+    // timeline semaphores pace frames, submits go through vkQueueSubmit2
+    VkPhysicalDeviceVulkan13Features features_13 = {};
+    features_13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    features_13.synchronization2 = VK_TRUE;
+
+    VkPhysicalDeviceVulkan12Features features_12 = {};
+    features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features_12.pNext = &features_13;
+    features_12.timelineSemaphore = VK_TRUE;
+    features_12.drawIndirectCount = gpu_culling;
+
+    features_12.descriptorIndexing = bindless;
+    features_12.runtimeDescriptorArray = bindless;
+    features_12.shaderSampledImageArrayNonUniformIndexing = bindless;
+    features_12.descriptorBindingPartiallyBound = bindless;
+    features_12.descriptorBindingSampledImageUpdateAfterBind = bindless;
+
+    VkPhysicalDeviceFeatures features = {};
+    features.multiDrawIndirect = gpu_culling;
+    features.drawIndirectFirstInstance = gpu_culling;
 
     VkDeviceCreateInfo device_create_info = {};
     device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    device_create_info.pEnabledFeatures = nullptr;
+    device_create_info.pNext = &features_12;
+    device_create_info.pEnabledFeatures = &features;
     device_create_info.queueCreateInfoCount = queue_create_infos.size();
     device_create_info.pQueueCreateInfos = queue_create_infos.data();
-    device_create_info.enabledLayerCount = validation_layers.size();
+    device_create_info.enabledLayerCount =
+        validation_supported() ? validation_layers.size() : 0;
     device_create_info.ppEnabledLayerNames = validation_layers.data();
-    device_create_info.enabledExtensionCount = device_extensions.size();
-    device_create_info.ppEnabledExtensionNames = device_extensions.data();
+    device_create_info.enabledExtensionCount = extensions.size();
+    device_create_info.ppEnabledExtensionNames = extensions.data();
 
     VK_CALL(vkCreateDevice(physical_device, &device_create_info, nullptr,
                            &render_info.device));
   }
 
-  // create main graphics queue
-  vkGetDeviceQueue(render_info.device, graphics_queue_family_index, 0,
+  // get queues, families without a dedicated queue alias the graphics queue
+  vkGetDeviceQueue(render_info.device, render_info.queue_families.graphics, 0,
                    &render_info.queue);
+  vkGetDeviceQueue(render_info.device, render_info.queue_families.compute, 0,
+                   &render_info.compute_queue);
+  vkGetDeviceQueue(render_info.device, render_info.queue_families.transfer, 0,
+                   &render_info.transfer_queue);
+
+  // uploads run on the transfer queue and are handed to the graphics family,
+  // they share queue_lock since the queues may alias
+  render_info.allocator =
+      std::make_unique<gpu_allocator_t>(physical_device, render_info.device);
+  render_info.uploads = std::make_unique<upload_context_t>(
+      render_info.device, render_info.transfer_queue,
+      render_info.queue_families.transfer, render_info.queue_families.graphics,
+      render_info.queue_families.transfer_granularity, *render_info.allocator,
+      upload_context_t::default_staging_size, &queue_lock);
+
+  startup_timings.mark(startup_phase_t::device);
+
+  // create render targets, swapchain images or device owned offscreen images
+  render_info.extent = {config.width, config.height};
+
+  // tiles are the size of the target, no larger than the image or the device
+  // allows
+  if (config.headless && config.tiled_width != 0 &&
+      config.tiled_height != 0) {
+    const auto limit = device_properties.limits.maxImageDimension2D;
+    render_info.extent = {
+        std::min({config.width, config.tiled_width, limit}),
+        std::min({config.height, config.tiled_height, limit})};
+    scene.tiles = {{config.tiled_width, config.tiled_height},
+                   render_info.extent};
+  }
 
-  // create swapchain and set extents
-  VkExtent2D swap_extent = {static_cast<uint32_t>(window_width),
-                            static_cast<uint32_t>(window_height)};
-  {
+  if (config.headless) {
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = surface_format.format;
+    image_info.extent = {render_info.extent.width, render_info.extent.height,
+                         1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    // one target per frame in flight
+    render_info.target_images.resize(config.frames_in_flight);
+    render_info.target_memory.resize(config.frames_in_flight);
+    for (uint32_t idx = 0; idx < config.frames_in_flight; idx += 1)
+      render_info.target_memory[idx] = render_info.allocator->create_image(
+          image_info, memory_usage_t::gpu_only, render_info.target_images[idx]);
+  } else {
     // physical device has max limit
     if (device_capabilities.currentExtent.width != UINT32_MAX)
-      swap_extent = device_capabilities.currentExtent;
+      render_info.extent = device_capabilities.currentExtent;
+
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    {
+      uint32_t mode_count = 0;
+      VK_CALL(vkGetPhysicalDeviceSurfacePresentModesKHR(
+          physical_device, render_info.surface, &mode_count, nullptr));
+
+      std::vector<VkPresentModeKHR> present_modes(mode_count);
+      VK_CALL(vkGetPhysicalDeviceSurfacePresentModesKHR(
+          physical_device, render_info.surface, &mode_count,
+          present_modes.data()));
+
+      present_mode = choose_present_mode(config.pacing, present_modes);
+      std::cout << "present mode: " << present_mode_name(present_mode)
+                << std::endl;
+    }
 
     VkSwapchainCreateInfoKHR swapchain_create_info = {};
     {
@@ -233,11 +437,11 @@ void chungus_application::initialize_graphics() {
       swapchain_create_info.clipped = VK_TRUE;
       swapchain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
       swapchain_create_info.preTransform = device_capabilities.currentTransform;
-      swapchain_create_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+      swapchain_create_info.presentMode = present_mode;
       swapchain_create_info.surface = surface;
       swapchain_create_info.imageArrayLayers = 1;
       swapchain_create_info.imageColorSpace = surface_format.colorSpace;
-      swapchain_create_info.imageExtent = swap_extent;
+      swapchain_create_info.imageExtent = render_info.extent;
       swapchain_create_info.imageFormat = surface_format.format;
       swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
       swapchain_create_info.minImageCount =
@@ -248,22 +452,71 @@ void chungus_application::initialize_graphics() {
 
     VK_CALL(vkCreateSwapchainKHR(render_info.device, &swapchain_create_info,
                                  nullptr, &render_info.swapchain));
-  }
 
-  // create swapchain images and views
-  {
+    // get swapchain images
     uint32_t image_count = 0;
     vkGetSwapchainImagesKHR(render_info.device, render_info.swapchain,
                             &image_count, nullptr);
     ASSERT(image_count != 0);
 
-    render_info.swap_images.resize(image_count);
+    render_info.target_images.resize(image_count);
     vkGetSwapchainImagesKHR(render_info.device, render_info.swapchain,
-                            &image_count, render_info.swap_images.data());
+                            &image_count, render_info.target_images.data());
   }
 
-  std::vector<VkImageView> swap_image_views;
-  swap_image_views.resize(render_info.swap_images.size());
+  startup_timings.mark(startup_phase_t::targets);
+
+  render_info.format = surface_format.format;
+
+  // create readback staging ring, one slot per frame in flight, sized for the
+  // converted layout when the gpu repacks frames before the copy to host
+  const auto readback_rect =
+      readback_region(render_info.extent, config.readback_crop);
+  render_info.readback_extent =
+      readback_extent(readback_rect, config.readback_scale);
+
+  const auto convert_readback =
+      config.readback_layout != readback_layout_t::rgba8 ||
+      config.readback_scale != 1 ||
+      readback_rect.extent.width != render_info.extent.width ||
+      readback_rect.extent.height != render_info.extent.height;
+  render_info.readback_layout =
+      convert_readback ? config.readback_layout : readback_layout_t::rgba8;
+
+  if (config.readback_callback) {
+    // a crop past the edge or a scale larger than the crop leaves nothing of
+    // the target, which is only known once the swapchain picked its size
+    if (render_info.readback_extent.width == 0 ||
+        render_info.readback_extent.height == 0) {
+      std::cerr << "readback: crop and scale leave nothing of the "
+                << render_info.extent.width << "x"
+                << render_info.extent.height << " target" << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+
+    render_info.readback.resize(config.frames_in_flight);
+
+    for (auto &slot : render_info.readback) {
+      slot.size = readback_size(render_info.readback_layout,
+                                render_info.readback_extent);
+
+      VkBufferCreateInfo buffer_info = {};
+      buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                          (convert_readback ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                            : 0);
+      buffer_info.size = slot.size;
+      buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      // cached memory keeps host reads fast
+      slot.allocation = render_info.allocator->create_buffer(
+          buffer_info, memory_usage_t::readback, slot.buffer);
+    }
+  }
+
+  startup_timings.mark(startup_phase_t::resources);
+
+  render_info.target_views.resize(render_info.target_images.size());
   {
 
     VkImageViewCreateInfo view_create_info = {};
@@ -278,83 +531,97 @@ void chungus_application::initialize_graphics() {
     view_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
     view_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
-    for (int idx = 0; idx < render_info.swap_images.size(); idx += 1) {
-      view_create_info.image = render_info.swap_images[idx];
+    for (int idx = 0; idx < render_info.target_images.size(); idx += 1) {
+      view_create_info.image = render_info.target_images[idx];
       VK_CALL(vkCreateImageView(render_info.device, &view_create_info, nullptr,
-                                &swap_image_views[idx]) != VK_SUCCESS);
+                                &render_info.target_views[idx]));
     }
   }
 
-  // create vertex buffer and copy in a demo triangle
-  std::vector<float> vertices = {0.0, -0.5, 0.5, 0.5, -0.5, 0.5};
-  VkBuffer vertex_buffer = {};
+  startup_timings.mark(startup_phase_t::targets);
+
+  // create vertex and index buffers for a demo triangle in device local
+  // memory, frames submitted after the flush see the uploaded data
+  const std::array<float, 6> vertices = {0.0, -0.5, 0.5, 0.5, -0.5, 0.5};
+  const std::array<uint16_t, 3> indices = {0, 1, 2};
+
   {
-    VkBufferCreateInfo buffer_info = {};
-    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buffer_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    buffer_info.size = sizeof(vertices[0]) * vertices.size();
-    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VK_CALL(vkCreateBuffer(render_info.device, &buffer_info, nullptr,
-                           &vertex_buffer));
+    scene.triangle_vertices = render_info.uploads->create_buffer(
+        std::as_bytes(std::span{vertices}), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        scene.triangle_vertex_memory);
+    scene.triangle_indices = render_info.uploads->create_buffer(
+        std::as_bytes(std::span{indices}), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        scene.triangle_index_memory);
+    scene.vertex_buffer = scene.triangle_vertices;
+    scene.index_buffer = scene.triangle_indices;
+    scene.index_count = indices.size();
   }
 
-  VkDeviceMemory vertex_buffer_memory = {};
+  // per instance attributes, one grid cell per instance, and their bounds
+  // for culling
   {
-    VkMemoryRequirements mem_requirements = {};
-    vkGetBufferMemoryRequirements(render_info.device, vertex_buffer,
-                                  &mem_requirements);
-
-    uint32_t memory_type_index = -1;
-    {
-      VkPhysicalDeviceMemoryProperties mem_properties = {};
-      vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
-
-      for (int i = 0; i < mem_properties.memoryTypeCount; i += 1) {
-        if ((mem_requirements.memoryTypeBits & (1 << i)) and
-            ((mem_properties.memoryTypes[i].propertyFlags &
-              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ==
-             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
-          memory_type_index = i;
-          break;
-        }
-      }
-
-      ASSERT(memory_type_index != -1);
+    scene.transforms = create_instance_grid(config.instance_count);
+
+    std::vector<instance_t> instances(config.instance_count);
+    std::vector<instance_bounds_t> bounds(config.instance_count);
+    write_transforms({0, config.instance_count}, instances, bounds);
+
+    scene.instance_buffer = render_info.uploads->create_buffer(
+        std::as_bytes(std::span{instances}),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        scene.instance_memory);
+    scene.bounds_buffer = render_info.uploads->create_buffer(
+        std::as_bytes(std::span{bounds}), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        scene.bounds_memory);
+
+    scene.camera.zoom = config.zoom;
+
+    // the shades materials used to be hard coded with
+    scene.materials.resize(4);
+    for (size_t index = 0; index < scene.materials.size(); index += 1) {
+      const auto shade = 1.0f - 0.2f * static_cast<float>(index);
+      scene.materials[index] = {{shade, shade, shade, 1.0f}};
     }
 
-    VkMemoryAllocateInfo alloc_info = {};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.memoryTypeIndex = memory_type_index;
-    alloc_info.allocationSize = mem_requirements.size;
-
-    VK_CALL(vkAllocateMemory(render_info.device, &alloc_info, nullptr,
-                             &vertex_buffer_memory));
-    VK_CALL(vkBindBufferMemory(render_info.device, vertex_buffer,
-                               vertex_buffer_memory, 0));
+    // instances are split evenly across draws
+    scene.instance_count = config.instance_count;
+    scene.draw_count =
+        std::clamp(config.draws_per_frame, 1u, scene.instance_count);
   }
 
-  // copy data into buffer
-  {
-    void *data = nullptr;
-    VK_CALL(vkMapMemory(render_info.device, vertex_buffer_memory, 0,
-                        VK_WHOLE_SIZE, 0, &data));
-    std::memcpy(data, vertices.data(), sizeof(float) * vertices.size());
+  const std::array uploaded = {scene.vertex_buffer, scene.index_buffer,
+                               scene.instance_buffer, scene.bounds_buffer};
+  render_info.uploads->flush(uploaded);
 
-    VkMappedMemoryRange memory_range = {};
-    {
-      memory_range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-      memory_range.memory = vertex_buffer_memory;
-      memory_range.size = VK_WHOLE_SIZE;
-      memory_range.offset = 0;
+  // replaces the triangle once streamed in
+  if (!config.mesh_path.empty())
+    scene.streamer = std::make_unique<mesh_streamer_t>(
+        config.mesh_path, *render_info.allocator, *render_info.uploads);
+
+  // materials take the textures in turn, drawn untextured until streamed in,
+  // or for good without bindless textures
+  {
+    std::vector<uint32_t> ids = {};
+    if (bindless) {
+      render_info.textures = std::make_unique<texture_streamer_t>(
+          render_info.device, *render_info.allocator, *render_info.uploads,
+          device_properties.limits, config.frames_in_flight,
+          config.texture_budget);
+
+      for (const auto path : config.texture_paths)
+        ids.push_back(render_info.textures->load(path));
     }
 
-    VK_CALL(vkFlushMappedMemoryRanges(render_info.device, 1, &memory_range));
-    vkUnmapMemory(render_info.device, vertex_buffer_memory);
+    scene.material_textures.assign(scene.materials.size(),
+                                   texture_streamer_t::default_texture);
+    for (size_t index = 0; index < scene.materials.size() && !ids.empty();
+         index += 1)
+      scene.material_textures[index] = ids[index % ids.size()];
   }
 
+  startup_timings.mark(startup_phase_t::resources);
+
   // create render pass
-  VkRenderPass render_pass = {};
   {
     VkAttachmentDescription color_attachment = {};
     color_attachment.format = surface_format.format;
@@ -364,7 +631,10 @@ void chungus_application::initialize_graphics() {
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color_attachment.finalLayout =
+        (config.headless || config.readback_callback)
+            ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+            : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference color_attachment_ref = {};
     color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -382,343 +652,735 @@ void chungus_application::initialize_graphics() {
     render_pass_info.pSubpasses = &subpass;
 
     VK_CALL(vkCreateRenderPass(render_info.device, &render_pass_info, nullptr,
-                               &render_pass));
+                               &render_info.render_pass));
   }
 
-  // vertex and fragment shaders
-  VkShaderModule vertex_shader_module = {};
-  VkShaderModule fragment_shader_module = {};
-  {
-    auto [vertex_shader, fragment_shader] = create_default_shaders();
-
-    VkShaderModuleCreateInfo vs_shader_info = {};
-    vs_shader_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    vs_shader_info.codeSize = vertex_shader.size();
-    vs_shader_info.pCode = reinterpret_cast<uint32_t *>(vertex_shader.data());
-
-    VkShaderModuleCreateInfo f_shader_info = {};
-    f_shader_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    f_shader_info.codeSize = fragment_shader.size();
-    f_shader_info.pCode = reinterpret_cast<uint32_t *>(fragment_shader.data());
-
-    VK_CALL(vkCreateShaderModule(render_info.device, &vs_shader_info, nullptr,
-                                 &vertex_shader_module));
-    VK_CALL(vkCreateShaderModule(render_info.device, &f_shader_info, nullptr,
-                                 &fragment_shader_module));
-  }
+  // pipeline cache, seeded from the previous run
+  if (!config.pipeline_cache_path.empty())
+    render_info.pipeline_cache =
+        load_pipeline_cache(render_info.device, device_properties,
+                            config.pipeline_cache_path);
+
+  // pipelines are compiled as background jobs, and again whenever a shader
+  // they use is rebuilt when watching the build's shader outputs
+  render_info.pipelines = std::make_unique<pipeline_manager_t>(
+      render_info.device, *jobs, config.shader_watch_dir);
 
-  // create graphics pipeline layout
-  VkPipelineLayout pipeline_layout = {};
+  // create graphics pipeline layout, frame data is bound as set 0, textures
+  // as set 1 when bindless and the camera is pushed to the vertex shader
   {
+    render_info.sets = std::make_unique<frame_descriptors_t>(
+        render_info.device, device_properties.limits, config.frames_in_flight);
+    std::vector<VkDescriptorSetLayout> set_layouts = {
+        render_info.sets->layout()};
+    if (render_info.textures)
+      set_layouts.push_back(render_info.textures->layout());
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    push_range.size = sizeof(camera_t);
+
     VkPipelineLayoutCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    create_info.setLayoutCount = set_layouts.size();
+    create_info.pSetLayouts = set_layouts.data();
+    create_info.pushConstantRangeCount = 1;
+    create_info.pPushConstantRanges = &push_range;
     VK_CALL(vkCreatePipelineLayout(render_info.device, &create_info, nullptr,
-                                   &pipeline_layout));
+                                   &render_info.pipeline_layout));
   }
 
-  // create render pipeline
-  VkPipeline pipeline = {};
+  // every pipeline below is compiled as a job while the framebuffers, frame
+  // resources and recorder are created, and waited for at the end
+  std::array<job_handle_t, 3> pipeline_jobs = {};
+
+  // scene pipelines by key, the default variant is compiled before the
+  // configured one is queued, which draws with it until compiled
   {
-    // shader stages
-    VkPipelineShaderStageCreateInfo vertex_stage = {};
-    vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertex_stage.module = vertex_shader_module;
-    vertex_stage.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fragment_stage = {};
-    fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragment_stage.module = fragment_shader_module;
-    fragment_stage.pName = "main";
-
-    std::array<VkPipelineShaderStageCreateInfo, 2> stages[] = {vertex_stage,
-                                                               fragment_stage};
-
-    // bindings
-    VkVertexInputBindingDescription binding_info = {};
-    binding_info.stride = sizeof(float) * 2;
-    binding_info.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    VkVertexInputAttributeDescription position_attr = {};
-    position_attr.binding = 0;
-    position_attr.location = 0;
-    position_attr.offset = 0;
-    position_attr.format = VK_FORMAT_R32G32_SFLOAT;
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    vertexInputInfo.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.pNext = NULL;
-    vertexInputInfo.flags = 0;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &binding_info;
-    vertexInputInfo.vertexAttributeDescriptionCount = 1;
-    vertexInputInfo.pVertexAttributeDescriptions = &position_attr;
-
-    // pipeline
-    VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
-    input_assembly.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    input_assembly.primitiveRestartEnable = VK_FALSE;
-
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = swap_extent.width;
-    viewport.height = swap_extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = swap_extent;
-
-    VkPipelineViewportStateCreateInfo viewport_state = {};
-    viewport_state.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
-    viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer = {};
-    rasterizer.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-    rasterizer.depthBiasConstantFactor = 0.0;
-    rasterizer.depthBiasClamp = 0.0;
-    rasterizer.depthBiasSlopeFactor = 0.0;
-    rasterizer.lineWidth = 1.0f;
-
-    VkPipelineMultisampleStateCreateInfo multisampling = {};
-    multisampling.sType =
-        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.minSampleShading = 0.0;
-    multisampling.pSampleMask = NULL;
-    multisampling.alphaToCoverageEnable = VK_FALSE;
-    multisampling.alphaToOneEnable = VK_FALSE;
-
-    VkPipelineColorBlendAttachmentState blend_att = {};
-    blend_att.blendEnable = VK_FALSE;
-    blend_att.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    blend_att.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    blend_att.colorBlendOp = VK_BLEND_OP_ADD;
-    blend_att.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blend_att.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blend_att.alphaBlendOp = VK_BLEND_OP_ADD;
-    blend_att.colorWriteMask =
-        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-    VkPipelineColorBlendStateCreateInfo blending = {};
-    blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    blending.logicOpEnable = VK_FALSE;
-    blending.logicOp = VK_LOGIC_OP_COPY;
-    blending.attachmentCount = 1;
-    blending.pAttachments = &blend_att;
-    blending.blendConstants[0] = 0.0f;
-    blending.blendConstants[1] = 0.0f;
-    blending.blendConstants[2] = 0.0f;
-    blending.blendConstants[3] = 0.0f;
-
-    VkGraphicsPipelineCreateInfo pipeline_info = {};
-    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_info.stageCount = 2;
-    pipeline_info.pStages = stages->data();
-    pipeline_info.pVertexInputState = &vertexInputInfo;
-    pipeline_info.pInputAssemblyState = &input_assembly;
-    pipeline_info.pViewportState = &viewport_state;
-    pipeline_info.pRasterizationState = &rasterizer;
-    pipeline_info.pMultisampleState = &multisampling;
-    pipeline_info.pColorBlendState = &blending;
-    pipeline_info.layout = pipeline_layout;
-    pipeline_info.renderPass = render_pass;
-    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
-
-    VK_CALL(vkCreateGraphicsPipelines(render_info.device, VK_NULL_HANDLE, 1,
-                                      &pipeline_info, nullptr, &pipeline));
+    const std::array<std::string_view, 2> shaders = {
+        "default.vert",
+        render_info.textures ? "default.frag" : "untextured.frag"};
+    render_info.variants = std::make_unique<pipeline_variants_t>(
+        *render_info.pipelines, render_info.device, render_info.pipeline_cache,
+        render_info.pipeline_layout, render_info.render_pass, shaders);
+
+    // without textures the default samples the white texel for nothing
+    const auto *variant = find_variant(scene_variants, config.pipeline_variant);
+    ASSERT(variant != nullptr);
+    if (variant == &scene_variants[0] &&
+        (config.texture_paths.empty() || !render_info.textures))
+      variant = find_variant(scene_variants, "untextured");
+
+    const std::array fallback = {jobs->submit(
+        [this] { render_info.variants->get(scene_variants[0].key); })};
+    pipeline_jobs[0] = jobs->submit(
+        [this, variant] {
+          render_info.pipeline = render_info.variants->get(variant->key);
+        },
+        fallback);
   }
 
-  std::vector<VkFramebuffer> frame_buffers(swap_image_views.size());
+  // compute pre-pass culling instances into indirect draws
+  if (gpu_culling)
+    pipeline_jobs[1] = jobs->submit([this,
+                                     &limits = device_properties.limits] {
+      render_info.culling = std::make_unique<gpu_culling_t>(
+          render_info.device, *render_info.allocator,
+          render_info.pipeline_cache, limits, scene.instance_count,
+          scene.draw_count, scene.instance_buffer, scene.bounds_buffer);
+    });
+
+  // compute pass shrinking frames before they are copied to host memory
+  if (config.readback_callback && convert_readback)
+    pipeline_jobs[2] = jobs->submit([this, readback_rect,
+                                     &limits = device_properties.limits] {
+      render_info.convert = std::make_unique<readback_converter_t>(
+          render_info.device, *render_info.allocator,
+          render_info.pipeline_cache, limits,
+          render_info.queue_families.graphics,
+          render_info.queue_families.compute, render_info.extent,
+          render_info.format, readback_rect, config.readback_scale,
+          config.readback_layout, render_info.readback);
+    });
+
+  startup_timings.mark(startup_phase_t::pipeline);
+
+  render_info.frame_buffers.resize(render_info.target_views.size());
   {
     VkFramebufferCreateInfo create_info = {};
     {
       create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-      create_info.renderPass = render_pass;
+      create_info.renderPass = render_info.render_pass;
       create_info.attachmentCount = 1;
-      create_info.width = swap_extent.width;
-      create_info.height = swap_extent.height;
+      create_info.width = render_info.extent.width;
+      create_info.height = render_info.extent.height;
       create_info.layers = 1;
     }
 
-    for (int index = 0; index < frame_buffers.size(); index += 1) {
-      create_info.pAttachments = &swap_image_views[index];
+    for (int index = 0; index < render_info.frame_buffers.size(); index += 1) {
+      create_info.pAttachments = &render_info.target_views[index];
       VK_CALL(vkCreateFramebuffer(render_info.device, &create_info, nullptr,
-                                  &frame_buffers[index]));
+                                  &render_info.frame_buffers[index]));
     }
   }
 
-  VkCommandPool cmd_pool = {};
-  {
-    VkCommandPoolCreateInfo create_info = {};
-    create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    create_info.queueFamilyIndex = graphics_queue_family_index;
-    VK_CALL(vkCreateCommandPool(render_info.device, &create_info, nullptr,
-                                &cmd_pool));
+  startup_timings.mark(startup_phase_t::targets);
+
+  // per frame in flight command pool, sync objects and transient memory
+  render_info.frames.resize(config.frames_in_flight);
+  for (uint32_t slot = 0; slot < config.frames_in_flight; slot += 1) {
+    auto &frame = render_info.frames[slot];
+    frame = create_frame_resources(
+        render_info.device, graphics_queue_family_index,
+        *render_info.allocator, config.transient_size);
+    render_info.sets->attach(slot, frame.transient);
   }
 
-  render_info.cmd_buffers.resize(swap_image_views.size());
-  {
-    VkCommandBufferAllocateInfo alloc_info = {};
-    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandPool = cmd_pool;
-    alloc_info.commandBufferCount = render_info.cmd_buffers.size();
-
-    // create command buffers
-    VK_CALL(vkAllocateCommandBuffers(render_info.device, &alloc_info,
-                                     render_info.cmd_buffers.data()));
+  render_info.scheduler = std::make_unique<frame_scheduler_t>(
+      render_info.device, config.frames_in_flight);
+
+  // create timestamp queries, a begin and end pair per frame in flight
+  if (timestamp_valid_bits != 0) {
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    render_info.timestamp_period = properties.limits.timestampPeriod;
+    render_info.timestamp_mask =
+        timestamp_valid_bits >= 64 ? UINT64_MAX
+                                   : (uint64_t{1} << timestamp_valid_bits) - 1;
+
+    VkQueryPoolCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    create_info.queryCount = 2 * config.frames_in_flight;
+
+    VK_CALL(vkCreateQueryPool(render_info.device, &create_info, nullptr,
+                              &render_info.timestamps));
   }
 
-  // record render comands
-  {
-    // begin all cmd buffers
-    {
-      VkCommandBufferBeginInfo begin_info = {};
-      begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  // draws are recorded into secondaries as jobs
+  render_info.recorder = std::make_unique<command_recorder_t>(
+      render_info.device, graphics_queue_family_index, config.frames_in_flight,
+      *jobs);
 
-      for (int index = 0; index < render_info.cmd_buffers.size(); index += 1)
-        VK_CALL(
-            vkBeginCommandBuffer(render_info.cmd_buffers[index], &begin_info));
-    }
+  startup_timings.mark(startup_phase_t::commands);
 
-    VkClearValue clear = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    VkRenderPassBeginInfo pass_info = {};
-    pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    pass_info.renderPass = render_pass;
-    // pass_info.framebuffer = frame_buffers[index];
-    pass_info.renderArea.offset = {0, 0};
-    pass_info.renderArea.extent = {swap_extent.width, swap_extent.height};
-    pass_info.clearValueCount = 1;
-    pass_info.pClearValues = &clear;
-
-    VkDeviceSize offsets[] = {0};
-    const uint32_t vertex_count = 3, instance_count = 1;
-
-    // issue draw calls
-    // clang-format off
-    for(int index = 0; index < render_info.cmd_buffers.size(); index += 1) {
-      pass_info.framebuffer = frame_buffers[index];
-
-      vkCmdBeginRenderPass(render_info.cmd_buffers[index], &pass_info, VK_SUBPASS_CONTENTS_INLINE);
-      vkCmdBindPipeline(render_info.cmd_buffers[index], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-      vkCmdBindVertexBuffers(render_info.cmd_buffers[index], 0, 1, &vertex_buffer, offsets);
-      vkCmdDraw(render_info.cmd_buffers[index], vertex_count, instance_count, 0, index);
-      vkCmdEndRenderPass(render_info.cmd_buffers[index]);
-    }
-    // clang-format on
+  jobs->wait(pipeline_jobs);
+  startup_timings.mark(startup_phase_t::pipeline);
+}
 
-    // end all cmd buffers
-    {
-      for (int index = 0; index < render_info.cmd_buffers.size(); index += 1)
-        VK_CALL(vkEndCommandBuffer(render_info.cmd_buffers[index]));
+void chungus_application::write_transforms(
+    const transform_system_t::range_t range,
+    const std::span<instance_t> instances,
+    const std::span<instance_bounds_t> bounds) {
+  // whole blocks per job, enough of them to be worth handing out
+  constexpr auto grain = transform_system_t::block_size * 64;
+
+  jobs->parallel_for(
+      range.count, grain, [&](const uint32_t first, const uint32_t count) {
+        scene.transforms->write({range.first + first, count},
+                                scene.mesh_radius,
+                                instances.subspan(first, count),
+                                bounds.subspan(first, count));
+      });
+}
+
+void chungus_application::update_scene(const uint64_t frame,
+                                       const float time) {
+  scene.uniforms.frame = static_cast<uint32_t>(frame);
+  scene.uniforms.time = time;
+
+  // tiles only draw the part of the target inside the image
+  scene.scissor = {{0, 0}, render_info.extent};
+  if (scene.tiles.count() != 0) {
+    const auto tile = static_cast<uint32_t>(frame);
+    set_tile_projection(scene.tiles, tile, scene.camera);
+    scene.scissor.extent = scene.tiles.rect(tile).extent;
+  }
+
+  // swap the streamed mesh in, record_frame acquires its buffers before the
+  // first draw and every bound has to be recomputed for its radius
+  if (scene.streamer && !scene.streamed) {
+    const auto state = scene.streamer->state();
+    if (state == mesh_streamer_t::state_t::ready) {
+      const auto &mesh = scene.streamer->mesh();
+      scene.vertex_buffer = mesh.vertex_buffer;
+      scene.index_buffer = mesh.index_buffer;
+      scene.index_count = mesh.index_count;
+      scene.index_type = mesh.index_type;
+      scene.mesh_radius = mesh.radius;
+
+      scene.transforms->mark_all();
+      scene.streamed = true;
+    } else if (state == mesh_streamer_t::state_t::failed) {
+      scene.streamer.reset();
     }
   }
+
+  // views grow as levels land, materials sample whatever is resident
+  if (render_info.textures) {
+    render_info.textures->begin_frame(frame,
+                                      render_info.scheduler->completed());
+    for (size_t index = 0; index < scene.materials.size(); index += 1)
+      scene.materials[index].texture_id =
+          render_info.textures->use(scene.material_textures[index], frame);
+  }
+
+  // spin the first few instances, only their blocks are uploaded again
+  const auto animated =
+      std::min(config.animated_instances, scene.instance_count);
+
+  scene.transforms->rotate(0, animated, 0.02f);
 }
 
-void chungus_application::main_loop() {
-  // create sync primitives
-  // clang-format off
-  const uint32_t images_in_flight = 2;
-  std::vector<VkSemaphore> sem_image_available(images_in_flight);
-  std::vector<VkSemaphore> sem_render_finished(images_in_flight);
-  std::vector<VkFence> fen_active(images_in_flight);
-  std::vector<VkFence> fen_images(render_info.swap_images.size(), VK_NULL_HANDLE);;
+VkCommandBuffer chungus_application::record_frame(const uint32_t frame_slot,
+                                                  const uint32_t image_index) {
+  auto &frame = render_info.frames[frame_slot];
+  auto cmd_buffer = frame.cmd_buffer;
+
+  VkCommandBufferInheritanceInfo inheritance = {};
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.renderPass = render_info.render_pass;
+  inheritance.subpass = 0;
+  inheritance.framebuffer = render_info.frame_buffers[image_index];
+
+  // one task per worker, each records a contiguous run of draws and each draw
+  // uses firstInstance to pick its slice of the instance buffer
+  //
+  // with gpu culling a single indirect call draws the compacted survivors
+  const auto &culling = render_info.culling;
+  const auto task_count =
+      culling ? 1u
+              : std::min(render_info.recorder->workers(), scene.draw_count);
+  const VkViewport viewport = {
+      0.0f, 0.0f, float(render_info.extent.width),
+      float(render_info.extent.height), 0.0f, 1.0f};
+
+  // this frame's uniforms and materials, bound with dynamic offsets
+  const auto frame_offsets =
+      render_info.sets->write(frame.transient, scene.uniforms, scene.materials);
+
+  const auto secondaries = render_info.recorder->record(
+      frame_slot, inheritance, task_count,
+      [&](VkCommandBuffer cmd, const uint32_t task) {
+        const VkBuffer vertex_buffers[] = {
+            scene.vertex_buffer,
+            culling ? culling->visible_instances() : scene.instance_buffer};
+        const VkDeviceSize offsets[] = {0, 0};
+
+        const auto draws = uint64_t{scene.draw_count};
+        const auto instances = uint64_t{scene.instance_count};
+
+        // clang-format off
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render_info.pipelines->get(render_info.pipeline));
+        vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkCmdSetScissor(cmd, 0, 1, &scene.scissor);
+        render_info.sets->bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render_info.pipeline_layout, frame_slot, frame_offsets);
+        if (render_info.textures)
+          render_info.textures->bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render_info.pipeline_layout, frame_slot);
+        vkCmdPushConstants(cmd, render_info.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(scene.camera), &scene.camera);
+        vkCmdBindVertexBuffers(cmd, 0, 2, vertex_buffers, offsets);
+        vkCmdBindIndexBuffer(cmd, scene.index_buffer, 0, scene.index_type);
+
+        if (culling) {
+          culling->draw(cmd);
+          return;
+        }
+
+        for (auto draw = draws * task / task_count; draw < draws * (task + 1) / task_count; draw += 1) {
+          const auto first = static_cast<uint32_t>(instances * draw / draws);
+          const auto last = static_cast<uint32_t>(instances * (draw + 1) / draws);
+          vkCmdDrawIndexed(cmd, scene.index_count, last - first, 0, 0, first);
+        }
+        // clang-format on
+      });
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  VK_CALL(vkBeginCommandBuffer(cmd_buffer, &begin_info));
+
+  // take ownership of everything uploaded since the last frame
+  frame.upload_wait = render_info.uploads->acquire(cmd_buffer);
+
+  // write instances changed since the last frame and their bounds straight
+  // into transient memory and copy them over, one region per run of dirty
+  // blocks, whatever does not fit is left dirty for the next frame
   {
-    VkSemaphoreCreateInfo sem_info = {};
-    sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    constexpr auto alignment = alignof(instance_bounds_t);
+    constexpr auto stride = sizeof(instance_t) + sizeof(instance_bounds_t);
+
+    std::vector<VkBufferCopy> instance_regions = {}, bounds_regions = {};
+    while (true) {
+      // one alignment of padding between the two ranges
+      const auto space = frame.transient.available(alignment);
+      const auto fits = space > alignment ? (space - alignment) / stride : 0;
+      const auto range = scene.transforms->next_dirty(static_cast<uint32_t>(
+          std::min<VkDeviceSize>(fits, scene.instance_count)));
+
+      if (range.count == 0)
+        break;
 
-    VkFenceCreateInfo fen_info = {};
-    fen_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fen_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+      const auto instance_bytes =
+          VkDeviceSize{range.count} * sizeof(instance_t);
+      const auto bounds_bytes =
+          VkDeviceSize{range.count} * sizeof(instance_bounds_t);
+      const auto instances =
+          frame.transient.allocate(instance_bytes, alignment);
+      const auto bounds = frame.transient.allocate(bounds_bytes, alignment);
+
+      write_transforms(
+          range,
+          {reinterpret_cast<instance_t *>(instances.data), range.count},
+          {reinterpret_cast<instance_bounds_t *>(bounds.data), range.count});
+
+      instance_regions.push_back(
+          {instances.offset, VkDeviceSize{range.first} * sizeof(instance_t),
+           instance_bytes});
+      bounds_regions.push_back(
+          {bounds.offset,
+           VkDeviceSize{range.first} * sizeof(instance_bounds_t),
+           bounds_bytes});
+    }
+
+    flush_allocation(render_info.device, frame.transient.memory);
+
+    if (!instance_regions.empty()) {
+      std::array<VkBufferMemoryBarrier, 2> barriers = {};
+      const std::array<VkBuffer, 2> dst_buffers = {scene.instance_buffer,
+                                                   scene.bounds_buffer};
+
+      // earlier frames may still be reading the data being replaced
+      for (size_t index = 0; index < barriers.size(); index += 1) {
+        auto &barrier = barriers[index];
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = dst_buffers[index];
+        barrier.size = VK_WHOLE_SIZE;
+      }
 
-    for(int index = 0; index < images_in_flight; index += 1) {
-      VK_CALL(vkCreateSemaphore(render_info.device, &sem_info, nullptr, &sem_image_available[index]));
-      VK_CALL(vkCreateSemaphore(render_info.device, &sem_info, nullptr, &sem_render_finished[index]));
-      VK_CALL(vkCreateFence(render_info.device, &fen_info, nullptr, &fen_active[index]));
+      // clang-format off
+      vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+      vkCmdCopyBuffer(cmd_buffer, frame.transient.buffer, scene.instance_buffer, instance_regions.size(), instance_regions.data());
+      vkCmdCopyBuffer(cmd_buffer, frame.transient.buffer, scene.bounds_buffer, bounds_regions.size(), bounds_regions.data());
+
+      for (auto &barrier : barriers) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+      }
+      vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, barriers.size(), barriers.data(), 0, nullptr);
+      // clang-format on
     }
   }
+
+  VkClearValue clear = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+  VkRenderPassBeginInfo pass_info = {};
+  pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  pass_info.renderPass = render_info.render_pass;
+  pass_info.framebuffer = render_info.frame_buffers[image_index];
+  pass_info.renderArea.offset = {0, 0};
+  pass_info.renderArea.extent = render_info.extent;
+  pass_info.clearValueCount = 1;
+  pass_info.pClearValues = &clear;
+
+  // layout targets are left in once the frame is done
+  const auto final_layout = config.headless
+                                ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  // clang-format off
+  if (render_info.timestamps != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(cmd_buffer, render_info.timestamps, 2 * frame_slot, 2);
+    vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, render_info.timestamps, 2 * frame_slot);
+  }
+
+  // timed along with the pass so culling is not free in the gpu numbers
+  if (culling)
+    culling->record(cmd_buffer, scene.camera, scene.index_count);
+
+  vkCmdBeginRenderPass(cmd_buffer, &pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  vkCmdExecuteCommands(cmd_buffer, secondaries.size(), secondaries.data());
+  vkCmdEndRenderPass(cmd_buffer);
+
+  if (render_info.timestamps != VK_NULL_HANDLE)
+    vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, render_info.timestamps, 2 * frame_slot + 1);
+
+  if (render_info.convert)
+    render_info.convert->record(cmd_buffer, render_info.target_images[image_index], frame_slot, final_layout);
+  else if (config.readback_callback)
+    record_readback(cmd_buffer, render_info.target_images[image_index], render_info.extent, render_info.readback[frame_slot], final_layout);
   // clang-format on
 
+  VK_CALL(vkEndCommandBuffer(cmd_buffer));
+  return cmd_buffer;
+}
+
+void chungus_application::main_loop() {
+  const auto running = [this](const uint64_t frame) {
+    if (config.frame_count != 0 && frame >= config.frame_count)
+      return false;
+
+    if (scene.tiles.count() != 0 && frame >= scene.tiles.count())
+      return false;
+
+    return config.headless || !glfwWindowShouldClose(window.get());
+  };
+
+  std::optional<frame_limiter_t> limiter = {};
+  if (config.pacing == pacing_mode_t::limited)
+    limiter.emplace(config.frame_rate_limit);
+
+  // read the render pass duration of the last frame recorded into a slot,
+  // warmup frames are read late and dropped by their number
+  std::vector<std::optional<uint64_t>> timestamp_frames(
+      config.frames_in_flight);
+  const auto collect_timestamps = [&](const uint32_t index) {
+    const auto pending = std::exchange(timestamp_frames[index], std::nullopt);
+    if (render_info.timestamps == VK_NULL_HANDLE || !pending ||
+        *pending < config.warmup_frames)
+      return;
+
+    std::array<uint64_t, 2> ticks = {};
+    const auto result = vkGetQueryPoolResults(
+        render_info.device, render_info.timestamps, 2 * index, 2,
+        sizeof(ticks), ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+    if (result == VK_SUCCESS) {
+      const auto elapsed =
+          ((ticks[1] - ticks[0]) & render_info.timestamp_mask) *
+          static_cast<double>(render_info.timestamp_period);
+      frame_timings.record(frame_stage_t::render_pass, elapsed / 1e6);
+    }
+  };
+
   // loop
-  uint32_t active_sync_index = 0;
-  while (!glfwWindowShouldClose(window.get())) {
-    glfwPollEvents();
-
-    VK_CALL(vkWaitForFences(render_info.device, 1,
-                            &fen_active[active_sync_index], VK_TRUE,
-                            UINT64_MAX));
-
-    uint32_t image_index = 0;
-    VK_CALL(vkAcquireNextImageKHR(
-        render_info.device, render_info.swapchain, UINT64_MAX,
-        sem_image_available[active_sync_index], VK_NULL_HANDLE, &image_index));
-
-    if (fen_images[image_index] != VK_NULL_HANDLE)
-      VK_CALL(vkWaitForFences(render_info.device, 1, &fen_images[image_index],
-                              VK_TRUE, UINT64_MAX));
-
-    fen_images[image_index] = fen_active[active_sync_index];
-    VkSemaphore sem_wait[] = {sem_image_available[active_sync_index]};
-    VkSemaphore sem_signal[] = {sem_render_finished[active_sync_index]};
-    VkPipelineStageFlags stages_wait[] = {
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-
-    VkSubmitInfo submit_info = {};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = sem_wait;
-    submit_info.pWaitDstStageMask = stages_wait;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &render_info.cmd_buffers[image_index];
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = sem_signal;
-    VK_CALL(
-        vkResetFences(render_info.device, 1, &fen_active[active_sync_index]));
+  const auto start = std::chrono::steady_clock::now();
+  for (uint64_t frame = 0; running(frame); frame += 1) {
+    // drop warmup frames from the statistics, before the first measured
+    // frame starts its timers
+    if (frame == config.warmup_frames && frame != 0)
+      frame_timings.clear();
 
-    // drawcall
-    VK_CALL(vkQueueSubmit(render_info.queue, 1, &submit_info,
-                          fen_active[active_sync_index]));
+    const stage_timer_t frame_timer{frame_timings, frame_stage_t::frame};
+
+    if (!config.headless)
+      glfwPollEvents();
 
-    VkPresentInfoKHR present_info;
+    const auto frame_slot =
+        static_cast<uint32_t>(frame % config.frames_in_flight);
+    auto &resources = render_info.frames[frame_slot];
+
+    // only blocks once the gpu falls frames_in_flight frames behind
+    {
+      const stage_timer_t timer{frame_timings, frame_stage_t::fence_wait};
+      render_info.scheduler->begin_frame(frame);
+    }
+
+    // the frame that last used this slot is done, recycle what it owned
+    collect_timestamps(frame_slot);
+    timestamp_frames[frame_slot] = frame;
+    reset_frame_resources(render_info.device, resources);
+
+    // pipelines compiled since the last frame are swapped in here and only
+    // here, so every draw of a frame uses the same ones
+    render_info.pipelines->begin_frame(frame,
+                                       render_info.scheduler->completed());
+
+    if (config.readback_callback) {
+      const stage_timer_t timer{frame_timings, frame_stage_t::readback};
+
+      auto &slot = render_info.readback[frame_slot];
+      deliver_readback(render_info.device, slot, render_info.readback_extent,
+                       render_info.format, render_info.readback_layout,
+                       config.readback_callback);
+
+      slot.frame = frame;
+      slot.pending = true;
+    }
+
+    // offscreen targets are owned per frame in flight, swapchain images are
+    // handed out by the presentation engine
+    uint32_t image_index = frame_slot;
+    if (!config.headless) {
+      const stage_timer_t timer{frame_timings, frame_stage_t::acquire};
+      VK_CALL(vkAcquireNextImageKHR(render_info.device, render_info.swapchain,
+                                    UINT64_MAX, resources.image_available,
+                                    VK_NULL_HANDLE, &image_index));
+    }
+
+    // rebuild the frame from scene state, an async readback conversion is
+    // recorded for the compute queue alongside it
+    const auto async_convert =
+        render_info.convert && render_info.convert->async();
+
+    VkCommandBuffer cmd_buffer = {}, convert_buffer = {};
+    {
+      const stage_timer_t timer{frame_timings, frame_stage_t::record};
+      const std::chrono::duration<float> time =
+          std::chrono::steady_clock::now() - start;
+      update_scene(frame, time.count());
+      cmd_buffer = record_frame(frame_slot, image_index);
+
+      if (async_convert)
+        convert_buffer = render_info.convert->record_async(frame_slot);
+    }
+
+    // uploads may come from another queue, wait until they have landed
+    std::array<VkSemaphoreSubmitInfo, 2> sem_wait = {};
+    uint32_t sem_wait_count = 0;
+    if (resources.upload_wait > 0) {
+      auto &wait = sem_wait[sem_wait_count++];
+      wait.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+      wait.semaphore = render_info.uploads->timeline();
+      wait.value = resources.upload_wait;
+      wait.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    }
+
+    if (!config.headless) {
+      auto &wait = sem_wait[sem_wait_count++];
+      wait.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+      wait.semaphore = resources.image_available;
+      wait.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+
+    // the timeline value marks the frame complete, the binary semaphore
+    // hands the image to present
+    std::array<VkSemaphoreSubmitInfo, 2> sem_signal = {};
+    sem_signal[0].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    sem_signal[0].semaphore = render_info.scheduler->timeline();
+    sem_signal[0].value = frame_scheduler_t::signal_value(frame);
+    sem_signal[0].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    sem_signal[1].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    sem_signal[1].semaphore = resources.render_finished;
+    sem_signal[1].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+    VkCommandBufferSubmitInfo cmd_info = {};
+    cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    cmd_info.commandBuffer = cmd_buffer;
+
+    VkSubmitInfo2 submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submit_info.waitSemaphoreInfoCount = sem_wait_count;
+    submit_info.pWaitSemaphoreInfos = sem_wait.data();
+    submit_info.commandBufferInfoCount = 1;
+    submit_info.pCommandBufferInfos = &cmd_info;
+    submit_info.signalSemaphoreInfoCount = config.headless ? 1 : 2;
+    submit_info.pSignalSemaphoreInfos = sem_signal.data();
+
+    // with an async conversion the frame hands its copy over instead, and
+    // is complete once the conversion waiting on it has run on the compute
+    // queue, overlapping the next frame's rendering
+    const auto frame_signal = sem_signal[0];
+    auto convert_wait = sem_signal[0];
+    VkCommandBufferSubmitInfo convert_info = {};
+    VkSubmitInfo2 convert_submit = {};
+    if (async_convert) {
+      sem_signal[0].semaphore = render_info.convert->copied();
+      convert_wait.semaphore = render_info.convert->copied();
+
+      convert_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+      convert_info.commandBuffer = convert_buffer;
+
+      convert_submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+      convert_submit.waitSemaphoreInfoCount = 1;
+      convert_submit.pWaitSemaphoreInfos = &convert_wait;
+      convert_submit.commandBufferInfoCount = 1;
+      convert_submit.pCommandBufferInfos = &convert_info;
+      convert_submit.signalSemaphoreInfoCount = 1;
+      convert_submit.pSignalSemaphoreInfos = &frame_signal;
+    }
+
+    // drawcall
     {
-      present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-      present_info.pNext = 0;
-      present_info.waitSemaphoreCount = 1;
-      present_info.pWaitSemaphores = sem_signal;
-      present_info.swapchainCount = 1;
-      present_info.pSwapchains = &render_info.swapchain;
-      present_info.pImageIndices = &image_index;
-      present_info.pResults = NULL;
+      const stage_timer_t timer{frame_timings, frame_stage_t::submit};
+      const std::scoped_lock lock{queue_lock};
+      VK_CALL(vkQueueSubmit2(render_info.queue, 1, &submit_info,
+                             VK_NULL_HANDLE));
+
+      if (async_convert)
+        VK_CALL(vkQueueSubmit2(render_info.compute_queue, 1, &convert_submit,
+                               VK_NULL_HANDLE));
+    }
+
+    if (!config.headless) {
+      VkPresentInfoKHR present_info;
+      {
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.pNext = 0;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &resources.render_finished;
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &render_info.swapchain;
+        present_info.pImageIndices = &image_index;
+        present_info.pResults = NULL;
+      }
+
+      // present
+      const stage_timer_t timer{frame_timings, frame_stage_t::present};
+      const std::scoped_lock lock{queue_lock};
+      vkQueuePresentKHR(render_info.queue, &present_info);
     }
 
-    // present
-    vkQueuePresentKHR(render_info.queue, &present_info);
-    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    if (limiter)
+      limiter->wait();
 
-    active_sync_index = (active_sync_index + 1) % images_in_flight;
+    if (config.timing_report_interval != 0 &&
+        (frame + 1) % config.timing_report_interval == 0)
+      frame_timings.print(std::cout);
   }
+
+  {
+    // the mesh streamer may still be submitting
+    const std::scoped_lock lock{queue_lock};
+    VK_CALL(vkDeviceWaitIdle(render_info.device));
+  }
+
+  for (uint32_t index = 0; index < timestamp_frames.size(); index += 1)
+    collect_timestamps(index);
+
+  if (config.print_timings) {
+    startup_timings.print(std::cout);
+    frame_timings.print(std::cout);
+  }
+
+  if (config.print_memory_stats)
+    render_info.allocator->stats().print(std::cout);
 }
 
 void chungus_application::cleanup_graphics() {
-  // TODO(vir): read image to cpu memory
+  // may still be streaming, use the upload context
+  scene.streamer.reset();
+  render_info.textures.reset();
+
+  // hand out frames still in the readback ring, oldest first
+  {
+    std::vector<readback_slot_t *> pending = {};
+    for (auto &slot : render_info.readback)
+      if (slot.pending)
+        pending.push_back(&slot);
+
+    std::sort(pending.begin(), pending.end(),
+              [](const auto *a, const auto *b) { return a->frame < b->frame; });
+
+    for (auto *slot : pending)
+      deliver_readback(render_info.device, *slot, render_info.readback_extent,
+                       render_info.format, render_info.readback_layout,
+                       config.readback_callback);
+  }
+
+  render_info.convert.reset();
+  for (auto &slot : render_info.readback)
+    render_info.allocator->destroy_buffer(slot.buffer, slot.allocation);
+
+  // the streamed mesh's buffers went with the streamer
+  render_info.allocator->destroy_buffer(scene.triangle_vertices,
+                                        scene.triangle_vertex_memory);
+  render_info.allocator->destroy_buffer(scene.triangle_indices,
+                                        scene.triangle_index_memory);
+  render_info.allocator->destroy_buffer(scene.instance_buffer,
+                                        scene.instance_memory);
+  render_info.allocator->destroy_buffer(scene.bounds_buffer,
+                                        scene.bounds_memory);
+
+  render_info.readback.clear();
+  render_info.uploads.reset();
+  render_info.variants.reset();
+  render_info.pipelines.reset();
+  render_info.recorder.reset();
+  render_info.culling.reset();
+  render_info.scheduler.reset();
+  render_info.sets.reset();
+
+  for (auto &frame : render_info.frames)
+    destroy_frame_resources(render_info.device, *render_info.allocator, frame);
+  render_info.frames.clear();
+
+  for (auto frame_buffer : render_info.frame_buffers)
+    vkDestroyFramebuffer(render_info.device, frame_buffer, nullptr);
+  render_info.frame_buffers.clear();
+
+  for (auto view : render_info.target_views)
+    vkDestroyImageView(render_info.device, view, nullptr);
+  render_info.target_views.clear();
+
+  // swapchain images belong to the swapchain, only offscreen ones have memory
+  for (size_t index = 0; index < render_info.target_memory.size(); index += 1)
+    render_info.allocator->destroy_image(render_info.target_images[index],
+                                         render_info.target_memory[index]);
+  render_info.target_images.clear();
+  render_info.target_memory.clear();
+
+  vkDestroyPipelineLayout(render_info.device, render_info.pipeline_layout,
+                          nullptr);
+  vkDestroyRenderPass(render_info.device, render_info.render_pass, nullptr);
+  vkDestroyQueryPool(render_info.device, render_info.timestamps, nullptr);
+  render_info.pipeline_layout = VK_NULL_HANDLE;
+  render_info.render_pass = VK_NULL_HANDLE;
+  render_info.timestamps = VK_NULL_HANDLE;
+
+  if (render_info.pipeline_cache != VK_NULL_HANDLE) {
+    save_pipeline_cache(render_info.device, render_info.pipeline_cache,
+                        config.pipeline_cache_path);
+    vkDestroyPipelineCache(render_info.device, render_info.pipeline_cache,
+                           nullptr);
+    render_info.pipeline_cache = VK_NULL_HANDLE;
+  }
+
+  jobs.reset();
+
+  // the allocator's blocks are freed while the device still exists
+  vkDestroySwapchainKHR(render_info.device, render_info.swapchain, nullptr);
+  vkDestroySurfaceKHR(instance, render_info.surface, nullptr);
+  render_info.swapchain = VK_NULL_HANDLE;
+  render_info.surface = VK_NULL_HANDLE;
+
+  render_info.allocator.reset();
+  vkDestroyDevice(render_info.device, nullptr);
+  vkDestroyInstance(instance, nullptr);
+  render_info.device = VK_NULL_HANDLE;
+  instance = VK_NULL_HANDLE;
 }
@@ -2,9 +2,33 @@
 
 #include <array>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
 #include <string_view>
 
+#include "command_recorder.hpp"
+#include "config.hpp"
+#include "culling.hpp"
+#include "frame_descriptors.hpp"
+#include "frame_resources.hpp"
+#include "frame_scheduler.hpp"
+#include "frame_timing.hpp"
 #include "globals.hpp"
+#include "gpu_memory.hpp"
+#include "instances.hpp"
+#include "job_system.hpp"
+#include "mesh_loader.hpp"
+#include "pipeline_manager.hpp"
+#include "pipeline_state.hpp"
+#include "queues.hpp"
+#include "readback.hpp"
+#include "readback_convert.hpp"
+#include "texture_streamer.hpp"
+#include "tiling.hpp"
+#include "transforms.hpp"
+#include "upload.hpp"
 
 #include <vulkan/vulkan.h>
 
@@ -13,8 +37,8 @@ private:
   static constexpr std::array<const char *, 1> validation_layers{
       "VK_LAYER_KHRONOS_validation"};
 
-  static constexpr std::array<const char *, 2> device_extensions{
-      VK_KHR_SWAPCHAIN_EXTENSION_NAME, "VK_KHR_portability_subset"};
+  static constexpr auto portability_subset_extension =
+      "VK_KHR_portability_subset";
 
   struct gflw_window_deleter {
     auto operator()(GLFWwindow *);
@@ -22,32 +46,123 @@ private:
 
   static auto create_glfw_window(const uint32_t, const uint32_t,
                                  const std::string_view);
-  static auto create_vulkan_instance(const std::string_view);
+  static auto create_vulkan_instance(const std::string_view, const bool);
 
-  static auto create_default_shaders();
+  static auto validation_supported();
 
 public:
-  explicit chungus_application(const uint32_t, const uint32_t,
-                               const std::string_view);
+  explicit chungus_application(const chungus_config_t &);
   ~chungus_application();
 
+  const frame_timings_t &timings() const { return frame_timings; }
+  const startup_timings_t &startup() const { return startup_timings; }
+  std::string_view device() const { return device_name; }
+
 private:
   void initialize_graphics();
   void main_loop();
   void cleanup_graphics();
 
-  const size_t window_height, window_width;
-  const std::string_view window_title;
+  // apply this frame's changes to the scene, marking what must be uploaded
+  void update_scene(const uint64_t frame, const float time);
+
+  // record the frame slot's primary for a target, draws are recorded into
+  // secondaries in parallel
+  VkCommandBuffer record_frame(const uint32_t, const uint32_t);
+
+  // instance records and bounds of a transform range, split across jobs
+  void write_transforms(const transform_system_t::range_t,
+                        std::span<instance_t>, std::span<instance_bounds_t>);
+
+  const chungus_config_t config;
 
   struct render_info_t {
-    VkDevice device = {};                          // logical device
-    VkQueue queue = {};                            // graphics queue
-    VkSwapchainKHR swapchain = {};                 // primary swapchain
-    std::vector<VkCommandBuffer> cmd_buffers = {}; // draw calls
-    std::vector<VkImage> swap_images = {};         // images
+    VkSurfaceKHR surface = {};                         // null when headless
+    VkDevice device = {};                              // logical device
+    VkQueue queue = {};                                // graphics queue
+    VkQueue compute_queue = {};                        // async or graphics
+    VkQueue transfer_queue = {};                       // async or graphics
+    queue_families_t queue_families = {};              // family per queue
+    VkSwapchainKHR swapchain = {};                     // primary swapchain
+    VkExtent2D extent = {};                            // render target extent
+    VkFormat format = {};                              // render target format
+    std::vector<frame_resources_t> frames = {};        // per frame in flight
+    std::vector<VkImage> target_images = {};           // swapchain or offscreen
+    std::vector<gpu_allocation_t> target_memory = {};  // offscreen image memory
+    std::vector<VkImageView> target_views = {};        // per target
+    std::vector<readback_slot_t> readback = {};        // staging ring
+    VkExtent2D readback_extent = {};                   // after crop and scale
+    readback_layout_t readback_layout = {};            // rgba8 unless converted
+    VkQueryPool timestamps = {};                       // render pass timing
+    float timestamp_period = 0.0f;                     // nanoseconds per tick
+    uint64_t timestamp_mask = 0;                       // valid timestamp bits
+    VkPipelineCache pipeline_cache = {};               // persisted across runs
+    std::unique_ptr<gpu_allocator_t> allocator = {};   // device memory pools
+    std::unique_ptr<upload_context_t> uploads = {};    // staging ring
+    std::unique_ptr<command_recorder_t> recorder = {}; // secondary recording
+    std::unique_ptr<frame_scheduler_t> scheduler = {}; // frame timeline
+    VkRenderPass render_pass = {};                     // main pass
+    std::unique_ptr<frame_descriptors_t> sets = {};    // frame data, set 0
+    std::unique_ptr<texture_streamer_t> textures = {}; // set 1, if bindless
+    VkPipelineLayout pipeline_layout = {};             // sets, camera
+    std::unique_ptr<pipeline_manager_t> pipelines = {}; // compiled off thread
+    std::unique_ptr<pipeline_variants_t> variants = {}; // scene, by key
+    pipeline_handle_t pipeline = 0;                    // configured variant
+    std::unique_ptr<gpu_culling_t> culling = {};       // null when cpu drawn
+    std::unique_ptr<readback_converter_t> convert = {}; // null when raw
+    std::vector<VkFramebuffer> frame_buffers = {};     // per target
   } render_info;
 
+  // held around every queue access, the mesh streamer submits uploads from
+  // its own thread
+  std::mutex queue_lock;
+
+  // startup, recording, transform writes and pipeline compiles, started
+  // before the window so its threads are up by the time there is work
+  std::unique_ptr<job_system_t> jobs = {};
+
+  struct scene_info_t {
+    VkBuffer vertex_buffer = {};   // per vertex positions
+    VkBuffer instance_buffer = {}; // per instance attributes
+    VkBuffer bounds_buffer = {};   // per instance bounds for culling
+    VkBuffer index_buffer = {};    // triangle list
+    gpu_allocation_t instance_memory = {}, bounds_memory = {};
+
+    // the demo triangle, drawn until a streamed mesh replaces it
+    VkBuffer triangle_vertices = {}, triangle_indices = {};
+    gpu_allocation_t triangle_vertex_memory = {}, triangle_index_memory = {};
+
+    VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+    uint32_t index_count = 0;      // indices per instance
+    uint32_t instance_count = 0;   // instances per frame
+    uint32_t draw_count = 0;       // draws the instances are split into
+    float mesh_radius = 0.71f;     // farthest vertex from the origin
+    camera_t camera = {};          // pushed to the vertex shader
+    VkRect2D scissor = {};         // drawn part of the target
+    tile_grid_t tiles = {};        // tiled mode, one tile per frame
+
+    // written to transient memory every frame and bound as set 0
+    frame_uniforms_t uniforms = {};
+    std::vector<material_t> materials = {}; // indexed by instance material
+
+    // id each material's texture was loaded as, what is drawn with is picked
+    // every frame by what is resident
+    std::vector<uint32_t> material_textures = {};
+
+    // loads config.mesh_path in the background, the triangle is drawn until
+    // streamed is set
+    std::unique_ptr<mesh_streamer_t> streamer = {};
+    bool streamed = false;
+
+    // source of the instance and bounds buffers, dirty blocks are written
+    // into transient memory and copied over every frame
+    std::optional<transform_system_t> transforms = {};
+  } scene;
+
   // render_info_t render_info;
+  frame_timings_t frame_timings;
+  startup_timings_t startup_timings;
+  std::string device_name;
 
   std::unique_ptr<GLFWwindow, gflw_window_deleter> window;
   VkInstance instance;
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+
+// fixed capacity multi producer multi consumer queue, neither side takes a
+// lock or allocates, push fails when full and pop fails when empty
+//
+// every cell carries a sequence number that tells producers and consumers
+// whose turn it is, a position is claimed with a compare exchange on head or
+// tail and published by bumping the cell's sequence
+template <typename T> class bounded_queue_t {
+public:
+  // capacity is rounded up to a power of two
+  explicit bounded_queue_t(const size_t capacity)
+      : cells{std::make_unique<cell_t[]>(std::bit_ceil(capacity))},
+        mask{std::bit_ceil(capacity) - 1} {
+    for (size_t index = 0; index <= mask; index += 1)
+      cells[index].sequence.store(index, std::memory_order_relaxed);
+  }
+
+  bounded_queue_t(const bounded_queue_t &) = delete;
+  bounded_queue_t &operator=(const bounded_queue_t &) = delete;
+
+  size_t capacity() const { return mask + 1; }
+
+  bool try_push(const T &value) {
+    auto position = tail.load(std::memory_order_relaxed);
+
+    while (true) {
+      auto &cell = cells[position & mask];
+      const auto sequence = cell.sequence.load(std::memory_order_acquire);
+      const auto lag = static_cast<std::ptrdiff_t>(sequence - position);
+
+      if (lag == 0) {
+        if (tail.compare_exchange_weak(position, position + 1,
+                                       std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false; // a lap behind, full
+      } else {
+        position = tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T &value) {
+    auto position = head.load(std::memory_order_relaxed);
+
+    while (true) {
+      auto &cell = cells[position & mask];
+      const auto sequence = cell.sequence.load(std::memory_order_acquire);
+      const auto lag = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+
+      if (lag == 0) {
+        if (head.compare_exchange_weak(position, position + 1,
+                                       std::memory_order_relaxed)) {
+          value = cell.value;
+          cell.sequence.store(position + mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false; // not yet published, empty
+      } else {
+        position = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  struct cell_t {
+    std::atomic<size_t> sequence = 0;
+    T value = {};
+  };
+
+  const std::unique_ptr<cell_t[]> cells;
+  const size_t mask;
+
+  // producers and consumers spin on different lines
+  alignas(64) std::atomic<size_t> tail = 0;
+  alignas(64) std::atomic<size_t> head = 0;
+};
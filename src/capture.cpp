@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <system_error>
+
+#include "capture.hpp"
+#include "image_codec.hpp"
+
+bool parse_capture_format(const std::string_view name,
+                          capture_format_t &format) {
+  if (name == "png")
+    format = capture_format_t::png;
+  else if (name == "qoi")
+    format = capture_format_t::qoi;
+  else if (name == "y4m")
+    format = capture_format_t::y4m;
+  else
+    return false;
+
+  return true;
+}
+
+void capture_stats_t::print(std::ostream &stream) const {
+  const auto flags = stream.flags();
+  const auto precision = stream.precision();
+  constexpr double mib = 1024.0 * 1024.0;
+
+  stream << "capture: " << written << " written, " << dropped << " dropped, "
+         << failed << " failed of " << offered << " frames" << std::endl;
+
+  stream << std::fixed << std::setprecision(3);
+  stream << "capture: " << bytes / mib << " MiB, peak depth " << peak_depth
+         << " / " << queue_depth << ", "
+         << (written != 0 ? encode_ms / written : 0.0) << " ms per frame on "
+         << threads << " encoders" << std::endl;
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+namespace {
+// raw readbacks copy texels as stored, only 8 bit four channel targets are
+// encoded
+bool texel_order(const readback_frame_t &frame, bool &bgra) {
+  bgra = false;
+  if (frame.layout != readback_layout_t::rgba8)
+    return true;
+
+  switch (frame.format) {
+  case VK_FORMAT_B8G8R8A8_SRGB:
+  case VK_FORMAT_B8G8R8A8_UNORM:
+    bgra = true;
+    return true;
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_R8G8B8A8_UNORM:
+    bgra = false;
+    return true;
+  default:
+    return false;
+  }
+}
+} // namespace
+
+capture_writer_t::capture_writer_t(const capture_options_t &options)
+    : options{options}, buffers(std::max(options.queue_depth, 1u)),
+      free_buffers{buffers.size()}, queued{buffers.size()} {
+  for (uint32_t index = 0; index < buffers.size(); index += 1)
+    free_buffers.try_push(index);
+
+  std::error_code error;
+  std::filesystem::create_directories(options.directory, error);
+  if (error)
+    std::cout << "capture: " << options.directory.string() << ": "
+              << error.message() << std::endl;
+
+  if (options.format == capture_format_t::y4m) {
+    const auto path = options.directory / "capture.y4m";
+    sequence_file.open(path, std::ios::binary);
+    if (!sequence_file)
+      std::cout << "capture: unable to open " << path.string() << std::endl;
+  }
+
+  // leave cores to the render thread and the job system
+  encoder_count =
+      options.threads != 0
+          ? options.threads
+          : std::clamp(std::thread::hardware_concurrency() / 2, 1u, 8u);
+
+  for (uint32_t index = 0; index < encoder_count; index += 1)
+    threads.emplace_back(&capture_writer_t::encoder_loop, this);
+}
+
+capture_writer_t::~capture_writer_t() { finish(); }
+
+void capture_writer_t::submit(const readback_frame_t &frame) {
+  offered.fetch_add(1, std::memory_order_relaxed);
+
+  // yuv planes can only be appended to a y4m sequence
+  bool bgra = false;
+  if (!texel_order(frame, bgra) ||
+      (frame.layout == readback_layout_t::yuv420 &&
+       options.format != capture_format_t::y4m)) {
+    failed.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  uint32_t index = 0;
+  if (!free_buffers.try_pop(index)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // the readback slot is recycled frames_in_flight frames later, which is
+  // too soon for the encoders, so the texels are copied out once
+  auto &buffer = buffers[index];
+  buffer.frame = frame.frame;
+  buffer.sequence = next_sequence++;
+  buffer.extent = frame.extent;
+  buffer.layout = frame.layout;
+  buffer.bgra = bgra;
+  buffer.texels.assign(frame.data.begin(), frame.data.end());
+
+  const auto queued_depth = depth.fetch_add(1, std::memory_order_relaxed) + 1;
+  peak_depth = std::max(peak_depth, queued_depth);
+
+  // never full, there are only as many indices as buffers
+  queued.try_push(index);
+
+  work.fetch_add(1, std::memory_order_release);
+  work.notify_one();
+}
+
+void capture_writer_t::finish() {
+  if (threads.empty())
+    return;
+
+  stopping.store(true, std::memory_order_release);
+  work.fetch_add(1, std::memory_order_release);
+  work.notify_all();
+
+  for (auto &thread : threads)
+    thread.join();
+
+  threads.clear();
+  sequence_file.close();
+}
+
+readback_layout_t capture_writer_t::readback_layout() const {
+  return options.format == capture_format_t::y4m ? readback_layout_t::yuv420
+                                                 : readback_layout_t::rgb8;
+}
+
+capture_stats_t capture_writer_t::stats() const {
+  capture_stats_t result = {};
+  result.offered = offered.load(std::memory_order_relaxed);
+  result.dropped = dropped.load(std::memory_order_relaxed);
+  result.written = written.load(std::memory_order_relaxed);
+  result.failed = failed.load(std::memory_order_relaxed);
+  result.bytes = bytes.load(std::memory_order_relaxed);
+  result.peak_depth = peak_depth;
+  result.queue_depth = static_cast<uint32_t>(buffers.size());
+  result.threads = encoder_count;
+  result.encode_ms = encode_ns.load(std::memory_order_relaxed) / 1e6;
+  return result;
+}
+
+void capture_writer_t::encoder_loop() {
+  // encoded output, reused so steady state encoding does not allocate
+  std::vector<std::byte> scratch;
+
+  while (true) {
+    // read before popping, a frame queued after a failed pop bumps it and
+    // the wait returns straight away
+    const auto observed = work.load(std::memory_order_acquire);
+
+    uint32_t index = 0;
+    if (!queued.try_pop(index)) {
+      if (stopping.load(std::memory_order_acquire))
+        return;
+
+      work.wait(observed, std::memory_order_acquire);
+      continue;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto ok = encode(buffers[index], scratch);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    encode_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+        std::memory_order_relaxed);
+    (ok ? written : failed).fetch_add(1, std::memory_order_relaxed);
+
+    depth.fetch_sub(1, std::memory_order_relaxed);
+    free_buffers.try_push(index);
+  }
+}
+
+bool capture_writer_t::encode(const frame_buffer_t &buffer,
+                              std::vector<std::byte> &scratch) {
+  const image_view_t image = {
+      .width = buffer.extent.width,
+      .height = buffer.extent.height,
+      .channels = buffer.layout == readback_layout_t::rgb8 ? 3u : 4u,
+      .bgra = buffer.bgra,
+      .texels = buffer.texels,
+  };
+
+  scratch.clear();
+  if (options.format == capture_format_t::y4m) {
+    if (buffer.layout == readback_layout_t::yuv420)
+      return append_sequence(buffer, buffer.texels);
+
+    convert_yuv420(image, scratch);
+    return append_sequence(buffer, scratch);
+  }
+
+  const auto png = options.format == capture_format_t::png;
+  if (png)
+    encode_png(image, scratch);
+  else
+    encode_qoi(image, scratch);
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "frame_%06llu.%s",
+                static_cast<unsigned long long>(buffer.frame),
+                png ? "png" : "qoi");
+
+  std::ofstream file{options.directory / name, std::ios::binary};
+  file.write(reinterpret_cast<const char *>(scratch.data()),
+             static_cast<std::streamsize>(scratch.size()));
+  if (!file)
+    return false;
+
+  bytes.fetch_add(scratch.size(), std::memory_order_relaxed);
+  return true;
+}
+
+bool capture_writer_t::append_sequence(const frame_buffer_t &buffer,
+                                       const std::vector<std::byte> &planes) {
+  // wait for every earlier frame, they were popped first so they are already
+  // being converted by other encoders
+  for (auto turn = next_append.load(std::memory_order_acquire);
+       turn != buffer.sequence;
+       turn = next_append.load(std::memory_order_acquire))
+    next_append.wait(turn, std::memory_order_acquire);
+
+  uint64_t appended = 0;
+  if (buffer.sequence == 0) {
+    // full range bt.601, square pixels, progressive
+    char header[96];
+    const auto size = std::snprintf(
+        header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n",
+        buffer.extent.width, buffer.extent.height, options.frame_rate);
+
+    sequence_file.write(header, size);
+    sequence_extent = buffer.extent;
+    appended += size;
+  }
+
+  // the extent is fixed by the header
+  const auto ok = sequence_file &&
+                  buffer.extent.width == sequence_extent.width &&
+                  buffer.extent.height == sequence_extent.height;
+
+  if (ok) {
+    sequence_file.write("FRAME\n", 6);
+    sequence_file.write(reinterpret_cast<const char *>(planes.data()),
+                        static_cast<std::streamsize>(planes.size()));
+    appended += 6 + planes.size();
+    bytes.fetch_add(appended, std::memory_order_relaxed);
+  }
+
+  next_append.fetch_add(1, std::memory_order_release);
+  next_append.notify_all();
+  return ok && sequence_file.good();
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "bounded_queue.hpp"
+#include "readback.hpp"
+
+enum class capture_format_t {
+  png, // frame_<n>.png per frame, uncompressed
+  qoi, // frame_<n>.qoi per frame
+  y4m, // one capture.y4m sequence, 4:2:0
+};
+
+bool parse_capture_format(const std::string_view, capture_format_t &);
+
+struct capture_options_t {
+  std::filesystem::path directory = {};
+  capture_format_t format = capture_format_t::qoi;
+  uint32_t threads = 0;     // encoder threads, 0 picks from cores
+  uint32_t queue_depth = 8; // frames buffered before new ones are dropped
+  uint32_t frame_rate = 60; // written to the y4m header
+};
+
+struct capture_stats_t {
+  uint64_t offered = 0;     // frames handed to submit
+  uint64_t dropped = 0;     // no free buffer, the encoders fell behind
+  uint64_t written = 0;     // encoded and written out
+  uint64_t failed = 0;      // unsupported format or a failed write
+  uint64_t bytes = 0;       // written to disk
+  uint32_t peak_depth = 0;  // most frames buffered at once
+  uint32_t queue_depth = 0; // buffers available
+  uint32_t threads = 0;     // encoder threads
+  double encode_ms = 0.0;   // summed over every written frame
+
+  void print(std::ostream &) const;
+};
+
+// encodes readback frames to disk on a pool of encoder threads
+//
+// submit() copies the frame out of the readback slot into a preallocated
+// buffer and queues it without locking, when every buffer is still waiting to
+// be encoded the frame is dropped instead so the render thread never waits
+// on the encoders
+//
+// png and qoi frames are encoded and written independently, y4m frames are
+// converted in parallel and appended to the sequence in submission order
+//
+// readback_layout() is the layout to ask the renderer for, so frames arrive
+// already repacked by the gpu and the encoders skip the swizzle
+class capture_writer_t {
+public:
+  explicit capture_writer_t(const capture_options_t &);
+  ~capture_writer_t();
+
+  capture_writer_t(const capture_writer_t &) = delete;
+  capture_writer_t &operator=(const capture_writer_t &) = delete;
+
+  // from the render thread only, usable as the readback callback
+  void submit(const readback_frame_t &);
+
+  // encode everything queued and join the encoders, no more frames may be
+  // submitted afterwards
+  void finish();
+
+  capture_stats_t stats() const;
+
+  readback_layout_t readback_layout() const;
+
+private:
+  struct frame_buffer_t {
+    uint64_t frame = 0;    // frame number, names png and qoi files
+    uint64_t sequence = 0; // position among accepted frames
+    VkExtent2D extent = {};
+    readback_layout_t layout = readback_layout_t::rgba8;
+    bool bgra = false;
+    std::vector<std::byte> texels = {}; // grown on first use, then reused
+  };
+
+  void encoder_loop();
+  bool encode(const frame_buffer_t &, std::vector<std::byte> &scratch);
+  bool append_sequence(const frame_buffer_t &,
+                       const std::vector<std::byte> &planes);
+
+  const capture_options_t options;
+
+  std::vector<frame_buffer_t> buffers;
+  bounded_queue_t<uint32_t> free_buffers, queued;
+  uint64_t next_sequence = 0; // render thread only
+
+  // bumped for every queued frame and on finish, encoders wait on it
+  std::atomic<uint32_t> work = 0;
+  std::atomic<bool> stopping = false;
+
+  // y4m, sequence number allowed to append next
+  std::atomic<uint64_t> next_append = 0;
+  std::ofstream sequence_file;
+  VkExtent2D sequence_extent = {};
+
+  std::atomic<uint32_t> depth = 0;
+  std::atomic<uint64_t> offered = 0, dropped = 0, written = 0, failed = 0;
+  std::atomic<uint64_t> bytes = 0, encode_ns = 0;
+  uint32_t peak_depth = 0; // render thread only
+
+  uint32_t encoder_count = 0;
+  std::vector<std::thread> threads = {};
+};
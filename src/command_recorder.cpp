@@ -0,0 +1,69 @@
+#include "globals.hpp"
+
+#include "command_recorder.hpp"
+
+command_recorder_t::command_recorder_t(VkDevice device,
+                                       const uint32_t queue_family_index,
+                                       const uint32_t frames_in_flight,
+                                       job_system_t &jobs)
+    : device{device}, frames_in_flight{frames_in_flight}, jobs{jobs} {
+  pools.resize(jobs.threads() * frames_in_flight);
+
+  VkCommandPoolCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  create_info.queueFamilyIndex = queue_family_index;
+
+  for (auto &pool : pools)
+    VK_CALL(vkCreateCommandPool(device, &create_info, nullptr, &pool.pool));
+}
+
+command_recorder_t::~command_recorder_t() {
+  for (auto &pool : pools)
+    vkDestroyCommandPool(device, pool.pool, nullptr);
+}
+
+std::span<const VkCommandBuffer>
+command_recorder_t::record(const uint32_t frame_slot,
+                           const VkCommandBufferInheritanceInfo &inheritance,
+                           const uint32_t task_count,
+                           const record_fn_t &record) {
+  recorded.assign(task_count, VK_NULL_HANDLE);
+  generation += 1;
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                     VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  begin_info.pInheritanceInfo = &inheritance;
+
+  // one job per task, whichever thread runs it records into its own pool
+  jobs.parallel_for(task_count, 1, [&](const uint32_t task, uint32_t) {
+    auto &pool = pools[jobs.thread_index() * frames_in_flight + frame_slot];
+    if (pool.generation != generation) {
+      VK_CALL(vkResetCommandPool(device, pool.pool, 0));
+      pool.generation = generation;
+      pool.used = 0;
+    }
+
+    if (pool.used == pool.buffers.size()) {
+      VkCommandBufferAllocateInfo alloc_info = {};
+      alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      alloc_info.commandPool = pool.pool;
+      alloc_info.commandBufferCount = 1;
+      VK_CALL(vkAllocateCommandBuffers(device, &alloc_info,
+                                       &pool.buffers.emplace_back()));
+    }
+
+    auto cmd_buffer = pool.buffers[pool.used++];
+
+    VK_CALL(vkBeginCommandBuffer(cmd_buffer, &begin_info));
+    record(cmd_buffer, task);
+    VK_CALL(vkEndCommandBuffer(cmd_buffer));
+
+    recorded[task] = cmd_buffer;
+  });
+
+  return recorded;
+}
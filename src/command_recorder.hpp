@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "job_system.hpp"
+
+// records secondary command buffers in parallel on the job system, the
+// calling thread records its share as well
+//
+// every job system thread owns one command pool per frame in flight, reset
+// the first time the thread records into it for a frame, so the caller must
+// have waited on the fence of the slot's previous submission and record()
+// must only be called from one thread at a time
+class command_recorder_t {
+public:
+  // records one task into a secondary buffer that has already been begun
+  using record_fn_t = std::function<void(VkCommandBuffer, const uint32_t)>;
+
+  command_recorder_t(VkDevice, const uint32_t queue_family_index,
+                     const uint32_t frames_in_flight, job_system_t &);
+  ~command_recorder_t();
+
+  command_recorder_t(const command_recorder_t &) = delete;
+  command_recorder_t &operator=(const command_recorder_t &) = delete;
+
+  uint32_t workers() const { return jobs.threads(); }
+
+  // record task_count secondary buffers continuing the inherited render pass,
+  // returned in task order and valid until the slot is recorded again
+  std::span<const VkCommandBuffer>
+  record(const uint32_t frame_slot, const VkCommandBufferInheritanceInfo &,
+         const uint32_t task_count, const record_fn_t &);
+
+private:
+  struct thread_pool_t {
+    VkCommandPool pool = {};
+    std::vector<VkCommandBuffer> buffers = {}; // grown on demand, reused
+    uint32_t used = 0;                         // buffers begun this record
+    uint64_t generation = 0;                   // record() it was reset for
+  };
+
+  VkDevice device;
+  const uint32_t frames_in_flight;
+  job_system_t &jobs;
+
+  // [thread * frames_in_flight + frame_slot]
+  std::vector<thread_pool_t> pools = {};
+  std::vector<VkCommandBuffer> recorded = {};
+  uint64_t generation = 0;
+};
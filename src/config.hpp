@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "frame_pacing.hpp"
+#include "readback.hpp"
+
+struct chungus_config_t {
+  uint32_t width = 800, height = 600;
+  std::string_view title = "chungus";
+
+  bool headless = false;             // render offscreen, no window/swapchain
+  uint64_t frame_count = 0;          // frames to render, 0 runs until closed
+  uint64_t warmup_frames = 0;        // frames left out of the timings
+  uint32_t instance_count = 1;       // instances per frame
+  uint32_t draws_per_frame = 1;      // draw calls the instances are split into
+  uint32_t worker_threads = 0;       // job system threads, 0 per core
+  uint32_t frames_in_flight = 2;     // frames queued before the cpu waits
+  bool async_queues = true;          // use dedicated compute/transfer queues
+  bool gpu_culling = true;           // cull and build draws in a compute pass
+  float zoom = 1.0f;                 // camera zoom, > 1 pushes instances out
+  uint32_t animated_instances = 0;   // instances moved and uploaded per frame
+  uint64_t transient_size = 4 << 20; // per frame scratch memory in bytes
+  std::string_view device_name = {}; // physical device filter, eg: llvmpipe
+  std::string_view mesh_path = {};   // .cmesh streamed in, a triangle if empty
+
+  // .ctex files streamed in and given to the materials in turn, resident
+  // textures are evicted least recently used first to stay under the budget
+  std::vector<std::string_view> texture_paths = {};
+  uint64_t texture_budget = uint64_t{256} << 20; // bytes
+
+  // headless only, renders one tiled_width x tiled_height image a tile per
+  // frame with width x height tiles, clamped to the device's image limit, the
+  // run ends after the last tile, 0 disables
+  uint32_t tiled_width = 0, tiled_height = 0;
+
+  // pipeline cache file reused across runs, empty disables the cache
+  std::string_view pipeline_cache_path = "chungus.pipeline_cache";
+
+  // name of one of scene_variants in pipeline_state.hpp, the default one
+  // skips texturing when no textures are given
+  std::string_view pipeline_variant = "default";
+
+  // directory of the build's generated .spv.inc files, pipelines are rebuilt
+  // in the background when one changes, empty disables reloading
+  std::string_view shader_watch_dir = {};
+
+  pacing_mode_t pacing = pacing_mode_t::vsync;
+  uint32_t frame_rate_limit = 60; // frames per second when pacing is limited
+
+  bool print_timings = false;          // print frame stage timings on exit
+  uint32_t timing_report_interval = 0; // print timings every n frames
+  bool print_memory_stats = false;     // print gpu memory pool usage on exit
+
+  // called with every rendered frame once the gpu copy to host memory has
+  // completed, no readback is recorded when empty
+  readback_callback_t readback_callback = {};
+
+  // anything but a full size rgba8 readback is converted by a compute pass
+  // before the copy to host memory
+  readback_layout_t readback_layout = readback_layout_t::rgba8;
+  uint32_t readback_scale = 1; // box filtered downscale factor
+  VkRect2D readback_crop = {}; // region of the target, all of it when empty
+};
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <array>
+
+#include "globals.hpp"
+
+#include "culling.hpp"
+#include "shader_registry.hpp"
+
+namespace {
+
+// matches constants_t in cull.comp and cull_draws.comp
+struct cull_constants_t {
+  camera_t camera = {};
+  uint32_t instance_count = 0;
+  uint32_t batch_size = 0;
+  uint32_t batch_count = 0;
+  uint32_t index_count = 0;
+};
+
+constexpr uint32_t workgroup_size = 64;
+
+} // namespace
+
+gpu_culling_t::gpu_culling_t(VkDevice device, gpu_allocator_t &allocator,
+                             VkPipelineCache pipeline_cache,
+                             const VkPhysicalDeviceLimits &limits,
+                             const uint32_t instance_count,
+                             const uint32_t draw_count, VkBuffer instances,
+                             VkBuffer bounds)
+    : device{device}, allocator{allocator}, instance_count{instance_count} {
+  ASSERT(instance_count > 0 && draw_count > 0);
+
+  // every draw covers batch_size instances except for the last one
+  batch_size = (instance_count + draw_count - 1) / draw_count;
+  batch_count = (instance_count + batch_size - 1) / batch_size;
+
+  // a few million instances already need more groups than x allows
+  cull_groups = dispatch_groups(
+      (instance_count + workgroup_size - 1) / workgroup_size, limits);
+  draws_groups = dispatch_groups(
+      (batch_count + workgroup_size - 1) / workgroup_size, limits);
+
+  {
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    buffer_info.size = VkDeviceSize{instance_count} * sizeof(instance_t);
+    buffer_info.usage =
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    visible_memory =
+        allocator.create_buffer(buffer_info, memory_usage_t::gpu_only, visible);
+
+    // draw count followed by the survivors of each batch
+    buffer_info.size = sizeof(uint32_t) * (1 + VkDeviceSize{batch_count});
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    counts_memory =
+        allocator.create_buffer(buffer_info, memory_usage_t::gpu_only, counts);
+
+    buffer_info.size =
+        sizeof(VkDrawIndexedIndirectCommand) * VkDeviceSize{batch_count};
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    commands_memory = allocator.create_buffer(
+        buffer_info, memory_usage_t::gpu_only, commands);
+  }
+
+  // instances, bounds, visible, counts, commands
+  const std::array<VkBuffer, 5> buffers = {instances, bounds, visible, counts,
+                                           commands};
+
+  {
+    std::array<VkDescriptorSetLayoutBinding, buffers.size()> bindings = {};
+    for (uint32_t index = 0; index < bindings.size(); index += 1) {
+      bindings[index].binding = index;
+      bindings[index].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      bindings[index].descriptorCount = 1;
+      bindings[index].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = bindings.size();
+    layout_info.pBindings = bindings.data();
+    VK_CALL(vkCreateDescriptorSetLayout(device, &layout_info, nullptr,
+                                        &set_layout));
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.size = sizeof(cull_constants_t);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_range;
+    VK_CALL(vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr,
+                                   &pipeline_layout));
+  }
+
+  {
+    VkDescriptorPoolSize pool_size = {};
+    pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount = buffers.size();
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    VK_CALL(vkCreateDescriptorPool(device, &pool_info, nullptr,
+                                   &descriptor_pool));
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &set_layout;
+    VK_CALL(vkAllocateDescriptorSets(device, &alloc_info, &descriptor_set));
+
+    std::array<VkDescriptorBufferInfo, buffers.size()> buffer_infos = {};
+    std::array<VkWriteDescriptorSet, buffers.size()> writes = {};
+    for (uint32_t index = 0; index < writes.size(); index += 1) {
+      buffer_infos[index] = {buffers[index], 0, VK_WHOLE_SIZE};
+
+      writes[index].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[index].dstSet = descriptor_set;
+      writes[index].dstBinding = index;
+      writes[index].descriptorCount = 1;
+      writes[index].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[index].pBufferInfo = &buffer_infos[index];
+    }
+
+    vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+  }
+
+  cull_pipeline = create_compute_pipeline(device, pipeline_cache,
+                                          pipeline_layout, "cull.comp");
+  draws_pipeline = create_compute_pipeline(device, pipeline_cache,
+                                           pipeline_layout, "cull_draws.comp");
+}
+
+gpu_culling_t::~gpu_culling_t() {
+  vkDestroyPipeline(device, draws_pipeline, nullptr);
+  vkDestroyPipeline(device, cull_pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+  vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+  vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+
+  allocator.destroy_buffer(commands, commands_memory);
+  allocator.destroy_buffer(counts, counts_memory);
+  allocator.destroy_buffer(visible, visible_memory);
+}
+
+void gpu_culling_t::record(VkCommandBuffer cmd_buffer, const camera_t &camera,
+                           const uint32_t index_count) const {
+  const cull_constants_t constants = {camera, instance_count, batch_size,
+                                      batch_count, index_count};
+
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+  // clang-format off
+  // earlier frames may still be drawing from the outputs
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+  vkCmdFillBuffer(cmd_buffer, counts, 0, VK_WHOLE_SIZE, 0);
+
+  // the cleared counts, and instances copied in earlier this frame
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+  vkCmdPushConstants(cmd_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+  vkCmdDispatch(cmd_buffer, cull_groups.width, cull_groups.height, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, draws_pipeline);
+  vkCmdDispatch(cmd_buffer, draws_groups.width, draws_groups.height, 1);
+
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  // clang-format on
+}
+
+void gpu_culling_t::draw(VkCommandBuffer cmd_buffer) const {
+  vkCmdDrawIndexedIndirectCount(cmd_buffer, commands, 0, counts, 0,
+                                batch_count,
+                                sizeof(VkDrawIndexedIndirectCommand));
+}
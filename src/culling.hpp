@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.hpp"
+#include "instances.hpp"
+
+// world space bounding circle of an instance, read by the culling pass
+struct instance_bounds_t {
+  float center[2] = {};
+  float radius = 0.0f;
+  float padding = 0.0f; // vec4 stride in std430
+};
+
+// frustum culls instances on the gpu and compacts the survivors, each draw
+// of the cpu split becomes an indirect command holding only its visible
+// instances and empty draws are dropped
+//
+// a single set of buffers is shared by all frames in flight, record() waits
+// for earlier draws to stop reading them before it overwrites them
+class gpu_culling_t {
+public:
+  gpu_culling_t(VkDevice, gpu_allocator_t &, VkPipelineCache,
+                const VkPhysicalDeviceLimits &, const uint32_t instance_count,
+                const uint32_t draw_count, VkBuffer instances,
+                VkBuffer bounds);
+  ~gpu_culling_t();
+
+  gpu_culling_t(const gpu_culling_t &) = delete;
+  gpu_culling_t &operator=(const gpu_culling_t &) = delete;
+
+  // compacted instances, bound in place of the instance buffer when drawing
+  VkBuffer visible_instances() const { return visible; }
+
+  // reset, cull and build the indirect commands, outside a render pass
+  void record(VkCommandBuffer, const camera_t &,
+              const uint32_t index_count) const;
+
+  // draw the indirect commands, index and vertex buffers must be bound
+  void draw(VkCommandBuffer) const;
+
+private:
+  VkDevice device;
+  gpu_allocator_t &allocator;
+  uint32_t instance_count;
+  uint32_t batch_size, batch_count; // draws before culling
+  VkExtent2D cull_groups, draws_groups;
+
+  VkBuffer visible = {}, counts = {}, commands = {};
+  gpu_allocation_t visible_memory = {}, counts_memory = {},
+                   commands_memory = {};
+
+  VkDescriptorSetLayout set_layout = {};
+  VkDescriptorPool descriptor_pool = {};
+  VkDescriptorSet descriptor_set = {};
+  VkPipelineLayout pipeline_layout = {};
+  VkPipeline cull_pipeline = {}, draws_pipeline = {};
+};
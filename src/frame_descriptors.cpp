@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "globals.hpp"
+
+#include "frame_descriptors.hpp"
+
+namespace {
+
+// the storage binding's range is fixed, every frame allocates the whole table
+constexpr VkDeviceSize material_range =
+    frame_descriptors_t::max_materials * sizeof(material_t);
+
+} // namespace
+
+frame_descriptors_t::frame_descriptors_t(VkDevice device,
+                                         const VkPhysicalDeviceLimits &limits,
+                                         const uint32_t frame_count)
+    : device{device},
+      uniform_alignment{limits.minUniformBufferOffsetAlignment},
+      storage_alignment{limits.minStorageBufferOffsetAlignment} {
+  ASSERT(frame_count > 0);
+  ASSERT(material_range <= limits.maxStorageBufferRange);
+
+  // uniforms, material table
+  {
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags =
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = bindings.size();
+    layout_info.pBindings = bindings.data();
+    VK_CALL(vkCreateDescriptorSetLayout(device, &layout_info, nullptr,
+                                        &set_layout));
+  }
+
+  {
+    const std::array<VkDescriptorPoolSize, 2> pool_sizes = {{
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame_count},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, frame_count},
+    }};
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = frame_count;
+    pool_info.poolSizeCount = pool_sizes.size();
+    pool_info.pPoolSizes = pool_sizes.data();
+    VK_CALL(vkCreateDescriptorPool(device, &pool_info, nullptr,
+                                   &descriptor_pool));
+
+    const std::vector<VkDescriptorSetLayout> layouts(frame_count, set_layout);
+    descriptor_sets.resize(frame_count);
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool;
+    alloc_info.descriptorSetCount = frame_count;
+    alloc_info.pSetLayouts = layouts.data();
+    VK_CALL(vkAllocateDescriptorSets(device, &alloc_info,
+                                     descriptor_sets.data()));
+  }
+}
+
+frame_descriptors_t::~frame_descriptors_t() {
+  vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+  vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+}
+
+void frame_descriptors_t::attach(const uint32_t slot,
+                                 const transient_buffer_t &transient) {
+  ASSERT(slot < descriptor_sets.size());
+
+  // offsets are supplied when binding, the ranges stay fixed
+  const std::array<VkDescriptorBufferInfo, 2> buffer_infos = {{
+      {transient.buffer, 0, sizeof(frame_uniforms_t)},
+      {transient.buffer, 0, material_range},
+  }};
+  const std::array<VkDescriptorType, 2> types = {
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC};
+
+  std::array<VkWriteDescriptorSet, 2> writes = {};
+  for (uint32_t index = 0; index < writes.size(); index += 1) {
+    writes[index].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[index].dstSet = descriptor_sets[slot];
+    writes[index].dstBinding = index;
+    writes[index].descriptorCount = 1;
+    writes[index].descriptorType = types[index];
+    writes[index].pBufferInfo = &buffer_infos[index];
+  }
+
+  vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+}
+
+frame_descriptors_t::offsets_t
+frame_descriptors_t::write(transient_buffer_t &transient,
+                           const frame_uniforms_t &uniforms,
+                           const std::span<const material_t> materials) const {
+  const auto uniform_range =
+      transient.allocate(sizeof(frame_uniforms_t), uniform_alignment);
+  const auto material_table =
+      transient.allocate(material_range, storage_alignment);
+  ASSERT(uniform_range.data != nullptr && material_table.data != nullptr);
+
+  auto frame = uniforms;
+  frame.material_count =
+      std::min<uint32_t>(static_cast<uint32_t>(materials.size()),
+                         max_materials);
+
+  std::memcpy(uniform_range.data, &frame, sizeof(frame));
+  std::memcpy(material_table.data, materials.data(),
+              frame.material_count * sizeof(material_t));
+
+  return {static_cast<uint32_t>(uniform_range.offset),
+          static_cast<uint32_t>(material_table.offset)};
+}
+
+void frame_descriptors_t::bind(VkCommandBuffer cmd_buffer,
+                               const VkPipelineBindPoint bind_point,
+                               VkPipelineLayout pipeline_layout,
+                               const uint32_t slot,
+                               const offsets_t offsets) const {
+  const std::array<uint32_t, 2> dynamic_offsets = {offsets.uniforms,
+                                                   offsets.materials};
+
+  // clang-format off
+  vkCmdBindDescriptorSets(cmd_buffer, bind_point, pipeline_layout, 0, 1, &descriptor_sets[slot], dynamic_offsets.size(), dynamic_offsets.data());
+  // clang-format on
+}
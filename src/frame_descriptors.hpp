@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "frame_resources.hpp"
+
+// per frame shader inputs, matches frame_t in default.frag
+struct frame_uniforms_t {
+  float time = 0.0f;           // seconds since the first frame
+  uint32_t frame = 0;          // frame number
+  uint32_t material_count = 0; // entries in the material table
+  uint32_t padding = 0;
+};
+
+// matches material_t in default.frag
+struct material_t {
+  float tint[4] = {1.0f, 1.0f, 1.0f, 1.0f}; // multiplies the shaded color
+  uint32_t texture_id = 0;                  // set 1 index, times the tint
+  uint32_t padding[3] = {};
+};
+
+// one descriptor set per frame in flight over that frame's transient buffer,
+// allocated once and never updated again
+//
+// every frame the uniforms and the material table are bump allocated from
+// the transient buffer and the set is bound with their offsets as dynamic
+// offsets, so nothing is mapped and no descriptor is written per frame
+//
+// data that changes per draw stays in push constants
+class frame_descriptors_t {
+public:
+  static constexpr uint32_t max_materials = 256;
+
+  frame_descriptors_t(VkDevice, const VkPhysicalDeviceLimits &,
+                      const uint32_t frame_count);
+  ~frame_descriptors_t();
+
+  frame_descriptors_t(const frame_descriptors_t &) = delete;
+  frame_descriptors_t &operator=(const frame_descriptors_t &) = delete;
+
+  // set 0 of every pipeline reading frame data
+  VkDescriptorSetLayout layout() const { return set_layout; }
+
+  // point a slot's set at its frame's transient buffer, once after creation
+  void attach(const uint32_t slot, const transient_buffer_t &);
+
+  // dynamic offsets of this frame's data, in binding order
+  struct offsets_t {
+    uint32_t uniforms = 0, materials = 0;
+  };
+
+  // copy into the frame's transient memory, flushed along with the rest of
+  // it, at most max_materials materials are visible to shaders
+  offsets_t write(transient_buffer_t &, const frame_uniforms_t &,
+                  std::span<const material_t>) const;
+
+  void bind(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout,
+            const uint32_t slot, const offsets_t) const;
+
+private:
+  VkDevice device;
+  const VkDeviceSize uniform_alignment, storage_alignment;
+
+  VkDescriptorSetLayout set_layout = {};
+  VkDescriptorPool descriptor_pool = {};
+  std::vector<VkDescriptorSet> descriptor_sets = {}; // per frame in flight
+};
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <array>
+#include <thread>
+
+#include "globals.hpp"
+
+#include "frame_pacing.hpp"
+
+bool parse_pacing_mode(const std::string_view name, pacing_mode_t &mode) {
+  if (name == "vsync")
+    mode = pacing_mode_t::vsync;
+  else if (name == "limited")
+    mode = pacing_mode_t::limited;
+  else if (name == "uncapped")
+    mode = pacing_mode_t::uncapped;
+  else
+    return false;
+
+  return true;
+}
+
+VkPresentModeKHR
+choose_present_mode(const pacing_mode_t mode,
+                    const std::span<const VkPresentModeKHR> available) {
+  // clang-format off
+  constexpr std::array<VkPresentModeKHR, 1> vsync_modes = {VK_PRESENT_MODE_FIFO_KHR};
+  constexpr std::array<VkPresentModeKHR, 2> limited_modes = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+  constexpr std::array<VkPresentModeKHR, 2> uncapped_modes = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+  // clang-format on
+
+  std::span<const VkPresentModeKHR> preferred = vsync_modes;
+  if (mode == pacing_mode_t::limited)
+    preferred = limited_modes;
+  else if (mode == pacing_mode_t::uncapped)
+    preferred = uncapped_modes;
+
+  for (const auto candidate : preferred)
+    if (std::find(available.begin(), available.end(), candidate) !=
+        available.end())
+      return candidate;
+
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+std::string_view present_mode_name(const VkPresentModeKHR mode) {
+  switch (mode) {
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return "mailbox";
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return "immediate";
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return "fifo";
+  default:
+    return "unknown";
+  }
+}
+
+frame_limiter_t::frame_limiter_t(const double frames_per_second,
+                                 const clock::duration spin_threshold)
+    : period(std::chrono::duration_cast<clock::duration>(
+          std::chrono::duration<double>(1.0 / frames_per_second))),
+      spin_threshold(spin_threshold), deadline(clock::now()) {
+  ASSERT(frames_per_second > 0.0);
+}
+
+void frame_limiter_t::wait() {
+  deadline += period;
+
+  // fell behind by more than a frame, restart the schedule instead of
+  // rendering a burst of frames to catch up
+  const auto now = clock::now();
+  if (deadline + period < now)
+    deadline = now;
+
+  if (deadline - now > spin_threshold)
+    std::this_thread::sleep_until(deadline - spin_threshold);
+
+  while (clock::now() < deadline)
+    std::this_thread::yield();
+}
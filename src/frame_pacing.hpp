@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <span>
+#include <string_view>
+
+#include <vulkan/vulkan.h>
+
+enum class pacing_mode_t {
+  vsync,    // fifo presentation, paced by the display
+  limited,  // low latency presentation, paced by the frame limiter
+  uncapped, // as fast as possible, for throughput measurement
+};
+
+bool parse_pacing_mode(const std::string_view, pacing_mode_t &);
+
+// pick the best present mode the surface reports for a pacing mode, falls back
+// to fifo which is always supported
+VkPresentModeKHR
+choose_present_mode(const pacing_mode_t,
+                    const std::span<const VkPresentModeKHR>);
+
+// name of a present mode choose_present_mode can return, for the startup log
+std::string_view present_mode_name(const VkPresentModeKHR);
+
+// paces frames to a fixed rate, sleeps until shortly before each deadline and
+// spins the rest of the way since sleeps overshoot by up to a scheduler tick
+class frame_limiter_t {
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit frame_limiter_t(const double frames_per_second,
+                           const clock::duration spin_threshold =
+                               std::chrono::microseconds(1500));
+
+  void wait();
+
+private:
+  const clock::duration period;
+  const clock::duration spin_threshold;
+  clock::time_point deadline;
+};
@@ -0,0 +1,95 @@
+#include "globals.hpp"
+
+#include "frame_resources.hpp"
+
+namespace {
+
+constexpr VkDeviceSize align_up(const VkDeviceSize value,
+                                const VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+VkDeviceSize
+transient_buffer_t::available(const VkDeviceSize alignment) const {
+  const auto offset = align_up(head, alignment);
+  return offset < capacity ? capacity - offset : 0;
+}
+
+transient_buffer_t::range_t
+transient_buffer_t::allocate(const VkDeviceSize size,
+                             const VkDeviceSize alignment) {
+  const auto offset = align_up(head, alignment);
+  if (offset + size > capacity)
+    return {};
+
+  head = offset + size;
+  return {offset, memory.mapped + offset};
+}
+
+frame_resources_t create_frame_resources(VkDevice device,
+                                         const uint32_t queue_family_index,
+                                         gpu_allocator_t &allocator,
+                                         const VkDeviceSize transient_size) {
+  frame_resources_t frame = {};
+
+  {
+    VkCommandPoolCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    create_info.queueFamilyIndex = queue_family_index;
+    VK_CALL(vkCreateCommandPool(device, &create_info, nullptr,
+                                &frame.cmd_pool));
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandPool = frame.cmd_pool;
+    alloc_info.commandBufferCount = 1;
+    VK_CALL(vkAllocateCommandBuffers(device, &alloc_info, &frame.cmd_buffer));
+  }
+
+  // binary semaphores for the swapchain, frame completion is tracked by the
+  // frame scheduler's timeline
+  {
+    VkSemaphoreCreateInfo sem_info = {};
+    sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VK_CALL(vkCreateSemaphore(device, &sem_info, nullptr,
+                              &frame.image_available));
+    VK_CALL(vkCreateSemaphore(device, &sem_info, nullptr,
+                              &frame.render_finished));
+  }
+
+  {
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.usage =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.size = transient_size;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    frame.transient.memory = allocator.create_buffer(
+        buffer_info, memory_usage_t::upload, frame.transient.buffer);
+    frame.transient.capacity = transient_size;
+  }
+
+  return frame;
+}
+
+void destroy_frame_resources(VkDevice device, gpu_allocator_t &allocator,
+                             frame_resources_t &frame) {
+  allocator.destroy_buffer(frame.transient.buffer, frame.transient.memory);
+  vkDestroySemaphore(device, frame.render_finished, nullptr);
+  vkDestroySemaphore(device, frame.image_available, nullptr);
+  vkDestroyCommandPool(device, frame.cmd_pool, nullptr);
+  frame = {};
+}
+
+void reset_frame_resources(VkDevice device, frame_resources_t &frame) {
+  VK_CALL(vkResetCommandPool(device, frame.cmd_pool, 0));
+  frame.transient.head = 0;
+}
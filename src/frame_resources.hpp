@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.hpp"
+
+// host visible scratch memory handed out front to back and reset as a whole,
+// for data that only lives for one frame
+struct transient_buffer_t {
+  VkBuffer buffer = {};
+  gpu_allocation_t memory = {};
+  VkDeviceSize capacity = 0; // buffer size, the allocation may be larger
+  VkDeviceSize head = 0;
+
+  struct range_t {
+    VkDeviceSize offset = 0; // offset into buffer
+    std::byte *data = nullptr;
+  };
+
+  VkDeviceSize available(const VkDeviceSize alignment) const;
+
+  // null data when the remaining space is too small
+  range_t allocate(const VkDeviceSize size, const VkDeviceSize alignment);
+};
+
+// everything a frame in flight records into or reads back, reused once the
+// frame scheduler reports the slot's previous frame complete
+struct frame_resources_t {
+  VkCommandPool cmd_pool = {};       // reset as a whole every frame
+  VkCommandBuffer cmd_buffer = {};   // primary
+  VkSemaphore image_available = {};  // acquire to render
+  VkSemaphore render_finished = {};  // render to present
+  transient_buffer_t transient = {}; // per frame uploads
+  uint64_t upload_wait = 0;          // upload ticket the submit waits on
+};
+
+frame_resources_t create_frame_resources(VkDevice,
+                                         const uint32_t queue_family_index,
+                                         gpu_allocator_t &,
+                                         const VkDeviceSize transient_size);
+
+void destroy_frame_resources(VkDevice, gpu_allocator_t &, frame_resources_t &);
+
+// recycle the frame's command pool and transient memory, the slot's previous
+// frame must have completed
+void reset_frame_resources(VkDevice, frame_resources_t &);
@@ -0,0 +1,46 @@
+#include "globals.hpp"
+
+#include "frame_scheduler.hpp"
+
+frame_scheduler_t::frame_scheduler_t(VkDevice device, const uint32_t depth)
+    : device{device}, frame_depth{depth} {
+  ASSERT(depth > 0);
+
+  VkSemaphoreTypeCreateInfo type_info = {};
+  type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  type_info.initialValue = 0;
+
+  VkSemaphoreCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  create_info.pNext = &type_info;
+  VK_CALL(vkCreateSemaphore(device, &create_info, nullptr, &semaphore));
+}
+
+frame_scheduler_t::~frame_scheduler_t() {
+  vkDestroySemaphore(device, semaphore, nullptr);
+}
+
+void frame_scheduler_t::begin_frame(const uint64_t frame) {
+  if (frame >= frame_depth)
+    wait(signal_value(frame - frame_depth));
+}
+
+uint64_t frame_scheduler_t::completed() {
+  VK_CALL(vkGetSemaphoreCounterValue(device, semaphore, &completed_value));
+  return completed_value;
+}
+
+void frame_scheduler_t::wait(const uint64_t value) {
+  if (completed_value >= value || completed() >= value)
+    return;
+
+  VkSemaphoreWaitInfo wait_info = {};
+  wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  wait_info.semaphoreCount = 1;
+  wait_info.pSemaphores = &semaphore;
+  wait_info.pValues = &value;
+  VK_CALL(vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+
+  completed_value = value;
+}
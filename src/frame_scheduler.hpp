@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+// paces frames with one timeline semaphore, frame n signals value n + 1 once
+// all of its work has completed
+//
+// the cpu only blocks when it gets more than depth frames ahead of the gpu
+class frame_scheduler_t {
+public:
+  frame_scheduler_t(VkDevice, const uint32_t depth);
+  ~frame_scheduler_t();
+
+  frame_scheduler_t(const frame_scheduler_t &) = delete;
+  frame_scheduler_t &operator=(const frame_scheduler_t &) = delete;
+
+  VkSemaphore timeline() const { return semaphore; }
+  uint32_t depth() const { return frame_depth; }
+
+  // value signaled by the frame's last submission
+  static uint64_t signal_value(const uint64_t frame) { return frame + 1; }
+
+  // block until the frame that last used frame's slot has completed, returns
+  // immediately while fewer than depth frames are in flight
+  void begin_frame(const uint64_t frame);
+
+  // highest value known to have been signaled, polls the semaphore
+  uint64_t completed();
+
+  // block until value has been signaled
+  void wait(const uint64_t value);
+
+private:
+  VkDevice device;
+  VkSemaphore semaphore = {};
+  const uint32_t frame_depth;
+  uint64_t completed_value = 0; // cached so most checks skip the driver
+};
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+
+#include "globals.hpp"
+
+#include "frame_timing.hpp"
+
+rolling_histogram_t::rolling_histogram_t(const size_t capacity)
+    : samples(capacity) {
+  ASSERT(capacity > 0);
+}
+
+void rolling_histogram_t::add(const double sample) {
+  samples[next] = sample;
+  next = (next + 1) % samples.size();
+  count = std::min(count + 1, samples.size());
+}
+
+void rolling_histogram_t::clear() { next = count = 0; }
+
+rolling_histogram_t::summary_t rolling_histogram_t::summary() const {
+  if (count == 0)
+    return {};
+
+  std::vector<double> sorted{samples.begin(), samples.begin() + count};
+  const auto percentile = [&](const double fraction) {
+    const auto rank = static_cast<size_t>(fraction * (sorted.size() - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+  };
+
+  summary_t result = {};
+  result.count = count;
+  result.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / count;
+  result.p50 = percentile(0.50);
+  result.p95 = percentile(0.95);
+  result.p99 = percentile(0.99);
+  return result;
+}
+
+void frame_timings_t::record(const frame_stage_t stage,
+                             const double milliseconds) {
+  const auto index = static_cast<size_t>(stage);
+  stages[index].add(milliseconds);
+  totals[index] += milliseconds;
+  counts[index] += 1;
+}
+
+void frame_timings_t::record(const frame_stage_t stage,
+                             const clock::time_point begin) {
+  const std::chrono::duration<double, std::milli> elapsed =
+      clock::now() - begin;
+  record(stage, elapsed.count());
+}
+
+void frame_timings_t::clear() {
+  for (auto &stage : stages)
+    stage.clear();
+
+  totals = {};
+  counts = {};
+}
+
+rolling_histogram_t::summary_t
+frame_timings_t::summary(const frame_stage_t stage) const {
+  return stages[static_cast<size_t>(stage)].summary();
+}
+
+double frame_timings_t::mean(const frame_stage_t stage) const {
+  const auto index = static_cast<size_t>(stage);
+  return counts[index] == 0 ? 0.0 : totals[index] / counts[index];
+}
+
+void frame_timings_t::print(std::ostream &stream) const {
+  const auto flags = stream.flags();
+  const auto precision = stream.precision();
+
+  stream << std::left << std::setw(12) << "stage" << std::right
+         << std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms"
+         << std::setw(10) << "p99 ms" << std::setw(10) << "mean ms"
+         << std::setw(10) << "samples" << std::endl;
+
+  stream << std::fixed << std::setprecision(3);
+  for (size_t index = 0; index < stages.size(); index += 1) {
+    const auto result = stages[index].summary();
+    if (result.count == 0)
+      continue;
+
+    stream << std::left << std::setw(12) << frame_stage_names[index]
+           << std::right << std::setw(10) << result.p50 << std::setw(10)
+           << result.p95 << std::setw(10) << result.p99 << std::setw(10)
+           << result.mean << std::setw(10) << result.count << std::endl;
+  }
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+void startup_timings_t::mark(const startup_phase_t phase) {
+  const auto now = clock::now();
+  const std::chrono::duration<double, std::milli> elapsed = now - last;
+
+  phases[static_cast<size_t>(phase)] += elapsed.count();
+  last = now;
+}
+
+double startup_timings_t::total() const {
+  return std::accumulate(phases.begin(), phases.end(), 0.0);
+}
+
+void startup_timings_t::print(std::ostream &stream) const {
+  const auto flags = stream.flags();
+  const auto precision = stream.precision();
+
+  stream << std::fixed << std::setprecision(3);
+  for (size_t index = 0; index < phases.size(); index += 1)
+    stream << std::left << std::setw(12) << startup_phase_names[index]
+           << std::right << std::setw(10) << phases[index] << " ms"
+           << std::endl;
+
+  stream << std::left << std::setw(12) << "total" << std::right
+         << std::setw(10) << total() << " ms" << std::endl;
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+enum class frame_stage_t : size_t {
+  acquire,     // cpu: vkAcquireNextImageKHR
+  fence_wait,  // cpu: timeline wait in frame_scheduler_t::begin_frame
+  record,      // cpu: command buffer recording
+  readback,    // cpu: readback callback
+  submit,      // cpu: vkQueueSubmit2
+  present,     // cpu: vkQueuePresentKHR
+  frame,       // cpu: whole loop iteration, including pacing
+  render_pass, // gpu: render pass, from timestamp queries
+  count,
+};
+
+constexpr std::array<std::string_view,
+                     static_cast<size_t>(frame_stage_t::count)>
+    frame_stage_names = {"acquire", "fence_wait", "record",   "readback",
+                         "submit",  "present",    "frame",    "gpu_pass"};
+
+enum class startup_phase_t : size_t {
+  instance,  // glfw window and vulkan instance
+  device,    // physical device, queues and logical device
+  targets,   // swapchain or offscreen images, views and framebuffers
+  resources, // buffers and readback staging
+  pipeline,  // render pass, pipeline cache and layouts, then the wait for
+             // the compile jobs, shader modules are created inside them
+  commands,  // command pools, queries and the recorder
+  count,
+};
+
+constexpr std::array<std::string_view,
+                     static_cast<size_t>(startup_phase_t::count)>
+    startup_phase_names = {"instance",  "device",   "targets",
+                           "resources", "pipeline", "commands"};
+
+// percentiles over the most recent samples, in milliseconds
+class rolling_histogram_t {
+public:
+  struct summary_t {
+    double p50 = 0, p95 = 0, p99 = 0, mean = 0;
+    size_t count = 0;
+  };
+
+  explicit rolling_histogram_t(const size_t capacity = 1024);
+
+  void add(const double);
+  void clear();
+  summary_t summary() const;
+
+private:
+  std::vector<double> samples;
+  size_t next = 0, count = 0;
+};
+
+class frame_timings_t {
+public:
+  using clock = std::chrono::steady_clock;
+
+  void record(const frame_stage_t, const double milliseconds);
+  void record(const frame_stage_t, const clock::time_point begin);
+  void clear();
+
+  // percentiles over the rolling window
+  rolling_histogram_t::summary_t summary(const frame_stage_t) const;
+
+  // mean over every sample since the last clear
+  double mean(const frame_stage_t) const;
+
+  void print(std::ostream &) const;
+
+private:
+  static constexpr auto stage_count = static_cast<size_t>(frame_stage_t::count);
+
+  std::array<rolling_histogram_t, stage_count> stages;
+  std::array<double, stage_count> totals = {};
+  std::array<uint64_t, stage_count> counts = {};
+};
+
+class startup_timings_t {
+public:
+  using clock = std::chrono::steady_clock;
+
+  // attribute the time since the previous mark to a phase
+  void mark(const startup_phase_t);
+  void restart() { last = clock::now(); }
+
+  double milliseconds(const startup_phase_t phase) const {
+    return phases[static_cast<size_t>(phase)];
+  }
+
+  double total() const;
+  void print(std::ostream &) const;
+
+private:
+  std::array<double, static_cast<size_t>(startup_phase_t::count)> phases = {};
+  clock::time_point last = clock::now();
+};
+
+// records the lifetime of a scope into a frame stage
+class stage_timer_t {
+public:
+  stage_timer_t(frame_timings_t &timings, const frame_stage_t stage)
+      : timings(timings), stage(stage), begin(frame_timings_t::clock::now()) {}
+  ~stage_timer_t() { timings.record(stage, begin); }
+
+private:
+  frame_timings_t &timings;
+  const frame_stage_t stage;
+  const frame_timings_t::clock::time_point begin;
+};
@@ -5,9 +5,22 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <cassert>
+
 #define ASSERT(x) assert(x)
-#define GLFW_CALL(x) ASSERT(x == GLFW_TRUE)
-#define VK_CALL(x) ASSERT(x == VK_SUCCESS)
+
+// evaluate x even when asserts are compiled out, eg: release builds
+#define GLFW_CALL(x)                                                           \
+  do {                                                                         \
+    [[maybe_unused]] const auto glfw_result = (x);                             \
+    ASSERT(glfw_result == GLFW_TRUE);                                          \
+  } while (0)
+
+#define VK_CALL(x)                                                             \
+  do {                                                                         \
+    [[maybe_unused]] const auto vk_result = (x);                               \
+    ASSERT(vk_result == VK_SUCCESS);                                           \
+  } while (0)
 
 #include <iostream>
 #include <vector>
@@ -0,0 +1,427 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <span>
+
+#include "globals.hpp"
+
+#include "gpu_memory.hpp"
+
+struct gpu_block_t {
+  struct range_t {
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+  };
+
+  VkDeviceMemory memory = {};
+  VkDeviceSize size = 0;
+  memory_usage_t usage = memory_usage_t::gpu_only;
+  uint32_t memory_type = 0;
+  resource_tiling_t tiling = resource_tiling_t::linear;
+  bool dedicated = false; // sized for one allocation, released when freed
+  bool coherent = true;
+  std::byte *mapped = nullptr;
+
+  uint32_t allocations = 0;
+  VkDeviceSize used = 0;
+  std::vector<range_t> free_ranges = {}; // sorted by offset, never adjacent
+};
+
+namespace {
+
+constexpr VkDeviceSize align_up(const VkDeviceSize value,
+                                const VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// first fit, the alignment padding in front stays a free range of its own
+bool take_range(gpu_block_t &block, const VkDeviceSize size,
+                const VkDeviceSize alignment, VkDeviceSize &offset) {
+  auto &ranges = block.free_ranges;
+  for (auto range = ranges.begin(); range != ranges.end(); range++) {
+    const auto aligned = align_up(range->offset, alignment);
+    const auto padding = aligned - range->offset;
+    if (padding + size > range->size)
+      continue;
+
+    offset = aligned;
+    const gpu_block_t::range_t tail = {aligned + size,
+                                       range->size - padding - size};
+
+    if (padding > 0) {
+      range->size = padding;
+      if (tail.size > 0)
+        ranges.insert(range + 1, tail);
+    } else if (tail.size > 0) {
+      *range = tail;
+    } else {
+      ranges.erase(range);
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+// insert in offset order and merge with the neighbours it touches
+void return_range(gpu_block_t &block, const VkDeviceSize offset,
+                  const VkDeviceSize size) {
+  auto &ranges = block.free_ranges;
+  auto next = std::lower_bound(ranges.begin(), ranges.end(), offset,
+                               [](const auto &range, const auto offset) {
+                                 return range.offset < offset;
+                               });
+
+  auto range = ranges.insert(next, {offset, size});
+
+  if (range + 1 != ranges.end() &&
+      range->offset + range->size == (range + 1)->offset) {
+    range->size += (range + 1)->size;
+    ranges.erase(range + 1);
+  }
+
+  if (range != ranges.begin() &&
+      (range - 1)->offset + (range - 1)->size == range->offset) {
+    (range - 1)->size += range->size;
+    ranges.erase(range);
+  }
+}
+
+void release_block(VkDevice device, gpu_block_t &block) {
+  if (block.mapped)
+    vkUnmapMemory(device, block.memory);
+
+  vkFreeMemory(device, block.memory, nullptr);
+  block.memory = VK_NULL_HANDLE;
+  block.mapped = nullptr;
+}
+
+VkMappedMemoryRange mapped_range(const gpu_allocation_t &allocation) {
+  VkMappedMemoryRange range = {};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = allocation.memory;
+  range.offset = allocation.offset;
+  range.size = allocation.size;
+  return range;
+}
+
+} // namespace
+
+void flush_allocation(VkDevice device, const gpu_allocation_t &allocation) {
+  if (allocation.coherent || allocation.block == nullptr)
+    return;
+
+  const auto range = mapped_range(allocation);
+  VK_CALL(vkFlushMappedMemoryRanges(device, 1, &range));
+}
+
+void invalidate_allocation(VkDevice device,
+                           const gpu_allocation_t &allocation) {
+  if (allocation.coherent || allocation.block == nullptr)
+    return;
+
+  const auto range = mapped_range(allocation);
+  VK_CALL(vkInvalidateMappedMemoryRanges(device, 1, &range));
+}
+
+double gpu_pool_stats_t::fragmentation() const {
+  const auto free = reserved - used;
+  if (free == 0)
+    return 0.0;
+
+  return 1.0 - static_cast<double>(block_free) / static_cast<double>(free);
+}
+
+void gpu_memory_stats_t::print(std::ostream &stream) const {
+  const auto flags = stream.flags();
+  const auto precision = stream.precision();
+  constexpr double mib = 1024.0 * 1024.0;
+
+  stream << std::left << std::setw(12) << "pool" << std::right
+         << std::setw(8) << "blocks" << std::setw(8) << "allocs"
+         << std::setw(14) << "reserved MiB" << std::setw(10) << "used MiB"
+         << std::setw(14) << "max free MiB" << std::setw(8) << "frag"
+         << std::endl;
+
+  stream << std::fixed << std::setprecision(3);
+  for (size_t index = 0; index < pools.size(); index += 1) {
+    const auto &pool = pools[index];
+    if (pool.blocks == 0)
+      continue;
+
+    stream << std::left << std::setw(12) << memory_usage_names[index]
+           << std::right << std::setw(8) << pool.blocks << std::setw(8)
+           << pool.allocations << std::setw(14) << pool.reserved / mib
+           << std::setw(10) << pool.used / mib << std::setw(14)
+           << pool.largest_free / mib << std::setw(8) << pool.fragmentation()
+           << std::endl;
+  }
+
+  stream << "device allocations: " << device_allocations << " / "
+         << max_device_allocations << std::endl;
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+gpu_allocator_t::gpu_allocator_t(VkPhysicalDevice physical_device,
+                                 VkDevice device,
+                                 const VkDeviceSize block_size)
+    : device{device}, block_size{block_size} {
+  vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  buffer_image_granularity = properties.limits.bufferImageGranularity;
+  non_coherent_atom_size = properties.limits.nonCoherentAtomSize;
+  max_device_allocations = properties.limits.maxMemoryAllocationCount;
+}
+
+gpu_allocator_t::~gpu_allocator_t() {
+  for (auto &pool : pools)
+    for (auto &block : pool)
+      release_block(device, *block);
+}
+
+uint32_t gpu_allocator_t::find_memory_type(const uint32_t type_bits,
+                                           const memory_usage_t usage) const {
+  // most preferred first, the last entry is the minimum requirement
+  // clang-format off
+  constexpr std::array<VkMemoryPropertyFlags, 2> gpu_only_flags = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0};
+  constexpr std::array<VkMemoryPropertyFlags, 2> upload_flags = {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT};
+  constexpr std::array<VkMemoryPropertyFlags, 3> readback_flags = {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT};
+  // clang-format on
+
+  std::span<const VkMemoryPropertyFlags> preferences = gpu_only_flags;
+  if (usage == memory_usage_t::upload)
+    preferences = upload_flags;
+  else if (usage == memory_usage_t::readback)
+    preferences = readback_flags;
+
+  for (const auto property_flags : preferences) {
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i += 1) {
+      if ((type_bits & (1 << i)) &&
+          ((memory_properties.memoryTypes[i].propertyFlags & property_flags) ==
+           property_flags))
+        return i;
+    }
+  }
+
+  // nothing to fall back to, and indexing memoryTypes with it is undefined
+  std::cerr << "gpu memory: no "
+            << memory_usage_names[static_cast<size_t>(usage)]
+            << " memory type for type bits " << type_bits << std::endl;
+  std::abort();
+}
+
+gpu_allocation_t
+gpu_allocator_t::allocate(const VkMemoryRequirements &requirements,
+                          const memory_usage_t usage,
+                          const resource_tiling_t tiling) {
+  const std::scoped_lock lock{mutex};
+
+  const auto memory_type = find_memory_type(requirements.memoryTypeBits, usage);
+  const auto property_flags =
+      memory_properties.memoryTypes[memory_type].propertyFlags;
+  const bool host_visible =
+      property_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  const bool coherent = property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  // keep flush and invalidate ranges from spilling into a neighbour
+  auto alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+  auto size = requirements.size;
+  if (host_visible && !coherent) {
+    alignment = std::max(alignment, non_coherent_atom_size);
+    size = align_up(size, non_coherent_atom_size);
+  }
+
+  auto &pool = pools[static_cast<size_t>(usage)];
+  const bool dedicated = size > block_size / 2;
+  const bool granular = buffer_image_granularity > 1;
+
+  gpu_block_t *block = nullptr;
+  VkDeviceSize offset = 0;
+  if (!dedicated) {
+    for (auto &candidate : pool) {
+      // an empty block can switch to the other tiling
+      if (candidate->memory_type != memory_type || candidate->dedicated ||
+          (granular && candidate->tiling != tiling &&
+           candidate->allocations > 0))
+        continue;
+
+      if (take_range(*candidate, size, alignment, offset)) {
+        block = candidate.get();
+        block->tiling = tiling;
+        break;
+      }
+    }
+  }
+
+  // no room, grab a new block from the driver
+  if (block == nullptr) {
+    uint32_t device_allocations = 0;
+    for (const auto &blocks : pools)
+      device_allocations += static_cast<uint32_t>(blocks.size());
+    ASSERT(device_allocations < max_device_allocations);
+
+    auto created = std::make_unique<gpu_block_t>();
+    created->size = dedicated ? size : block_size;
+    created->usage = usage;
+    created->memory_type = memory_type;
+    created->tiling = tiling;
+    created->dedicated = dedicated;
+    created->coherent = coherent;
+    created->free_ranges = {{0, created->size}};
+
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = created->size;
+    alloc_info.memoryTypeIndex = memory_type;
+
+    VK_CALL(vkAllocateMemory(device, &alloc_info, nullptr, &created->memory));
+
+    // host visible blocks stay mapped for their lifetime
+    if (host_visible) {
+      void *data = nullptr;
+      VK_CALL(vkMapMemory(device, created->memory, 0, VK_WHOLE_SIZE, 0, &data));
+      created->mapped = static_cast<std::byte *>(data);
+    }
+
+    const auto taken = take_range(*created, size, alignment, offset);
+    ASSERT(taken);
+
+    block = created.get();
+    pool.push_back(std::move(created));
+  }
+
+  block->allocations += 1;
+  block->used += size;
+
+  gpu_allocation_t allocation = {};
+  allocation.memory = block->memory;
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.mapped = block->mapped ? block->mapped + offset : nullptr;
+  allocation.coherent = block->coherent;
+  allocation.block = block;
+  return allocation;
+}
+
+void gpu_allocator_t::free(gpu_allocation_t &allocation) {
+  if (allocation.block == nullptr)
+    return;
+
+  const std::scoped_lock lock{mutex};
+
+  auto *block = allocation.block;
+  return_range(*block, allocation.offset, allocation.size);
+  block->allocations -= 1;
+  block->used -= allocation.size;
+
+  if (block->allocations > 0) {
+    allocation = {};
+    return;
+  }
+
+  // dedicated blocks go back now, one empty shared block per memory type is
+  // kept around so a pool emptying and refilling does not hit the driver
+  auto &pool = pools[static_cast<size_t>(block->usage)];
+  const auto spare =
+      std::any_of(pool.begin(), pool.end(), [&](const auto &candidate) {
+        return candidate.get() != block && !candidate->dedicated &&
+               candidate->memory_type == block->memory_type &&
+               candidate->allocations == 0;
+      });
+
+  if (block->dedicated || spare) {
+    const auto owner =
+        std::find_if(pool.begin(), pool.end(), [&](const auto &candidate) {
+          return candidate.get() == block;
+        });
+    ASSERT(owner != pool.end());
+
+    release_block(device, *block);
+    pool.erase(owner);
+  }
+
+  allocation = {};
+}
+
+gpu_allocation_t
+gpu_allocator_t::create_buffer(const VkBufferCreateInfo &create_info,
+                               const memory_usage_t usage, VkBuffer &buffer) {
+  VK_CALL(vkCreateBuffer(device, &create_info, nullptr, &buffer));
+
+  VkMemoryRequirements mem_requirements = {};
+  vkGetBufferMemoryRequirements(device, buffer, &mem_requirements);
+
+  auto allocation =
+      allocate(mem_requirements, usage, resource_tiling_t::linear);
+  VK_CALL(vkBindBufferMemory(device, buffer, allocation.memory,
+                             allocation.offset));
+  return allocation;
+}
+
+gpu_allocation_t
+gpu_allocator_t::create_image(const VkImageCreateInfo &create_info,
+                              const memory_usage_t usage, VkImage &image) {
+  VK_CALL(vkCreateImage(device, &create_info, nullptr, &image));
+
+  VkMemoryRequirements mem_requirements = {};
+  vkGetImageMemoryRequirements(device, image, &mem_requirements);
+
+  const auto tiling = create_info.tiling == VK_IMAGE_TILING_OPTIMAL
+                          ? resource_tiling_t::optimal
+                          : resource_tiling_t::linear;
+
+  auto allocation = allocate(mem_requirements, usage, tiling);
+  VK_CALL(vkBindImageMemory(device, image, allocation.memory,
+                            allocation.offset));
+  return allocation;
+}
+
+void gpu_allocator_t::destroy_buffer(VkBuffer buffer,
+                                     gpu_allocation_t &allocation) {
+  vkDestroyBuffer(device, buffer, nullptr);
+  free(allocation);
+}
+
+void gpu_allocator_t::destroy_image(VkImage image,
+                                    gpu_allocation_t &allocation) {
+  vkDestroyImage(device, image, nullptr);
+  free(allocation);
+}
+
+gpu_memory_stats_t gpu_allocator_t::stats() const {
+  const std::scoped_lock lock{mutex};
+
+  gpu_memory_stats_t stats = {};
+  stats.max_device_allocations = max_device_allocations;
+
+  for (size_t index = 0; index < pools.size(); index += 1) {
+    auto &pool_stats = stats.pools[index];
+
+    for (const auto &block : pools[index]) {
+      pool_stats.blocks += 1;
+      pool_stats.allocations += block->allocations;
+      pool_stats.free_ranges +=
+          static_cast<uint32_t>(block->free_ranges.size());
+      pool_stats.reserved += block->size;
+      pool_stats.used += block->used;
+
+      VkDeviceSize largest = 0;
+      for (const auto &range : block->free_ranges)
+        largest = std::max(largest, range.size);
+
+      pool_stats.largest_free = std::max(pool_stats.largest_free, largest);
+      pool_stats.block_free += largest;
+    }
+
+    stats.device_allocations += pool_stats.blocks;
+  }
+
+  return stats;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// each usage draws from its own pool of blocks
+enum class memory_usage_t : size_t {
+  gpu_only, // device local, never mapped
+  upload,   // host visible, written by the cpu and read by the gpu
+  readback, // host visible and cached, written by the gpu and read by the cpu
+  count,
+};
+
+constexpr std::array<std::string_view,
+                     static_cast<size_t>(memory_usage_t::count)>
+    memory_usage_names = {"gpu_only", "upload", "readback"};
+
+// buffers and linear images may not share a bufferImageGranularity page with
+// optimal images
+enum class resource_tiling_t { linear, optimal };
+
+struct gpu_block_t;
+
+// a range of a larger VkDeviceMemory block
+struct gpu_allocation_t {
+  VkDeviceMemory memory = {};
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  std::byte *mapped = nullptr; // host pointer at offset, null for gpu_only
+  bool coherent = true;        // no flush or invalidate needed
+
+  gpu_block_t *block = nullptr; // owning block, null when not allocated
+};
+
+// make host writes visible to the gpu, no-op on coherent memory
+void flush_allocation(VkDevice, const gpu_allocation_t &);
+
+// make gpu writes visible to the host, no-op on coherent memory
+void invalidate_allocation(VkDevice, const gpu_allocation_t &);
+
+struct gpu_pool_stats_t {
+  uint32_t blocks = 0;           // device memory objects
+  uint32_t allocations = 0;      // live sub-allocations
+  uint32_t free_ranges = 0;      // holes between sub-allocations
+  VkDeviceSize reserved = 0;     // bytes allocated from the driver
+  VkDeviceSize used = 0;         // bytes handed out
+  VkDeviceSize largest_free = 0; // largest contiguous free range
+  VkDeviceSize block_free = 0;   // sum of each block's largest free range
+
+  // 0 when each block's free space is one range, approaches 1 as it splinters
+  double fragmentation() const;
+};
+
+struct gpu_memory_stats_t {
+  std::array<gpu_pool_stats_t, static_cast<size_t>(memory_usage_t::count)>
+      pools = {};
+  uint32_t device_allocations = 0;     // across all pools
+  uint32_t max_device_allocations = 0; // maxMemoryAllocationCount
+
+  void print(std::ostream &) const;
+};
+
+// sub-allocates resources out of large device memory blocks, keeping one list
+// of blocks per pool and memory type, free space is a sorted list of ranges
+// handed out first fit and coalesced on free
+class gpu_allocator_t {
+public:
+  static constexpr VkDeviceSize default_block_size = VkDeviceSize{64} << 20;
+
+  gpu_allocator_t(VkPhysicalDevice, VkDevice,
+                  const VkDeviceSize block_size = default_block_size);
+  ~gpu_allocator_t();
+
+  gpu_allocator_t(const gpu_allocator_t &) = delete;
+  gpu_allocator_t &operator=(const gpu_allocator_t &) = delete;
+
+  gpu_allocation_t allocate(const VkMemoryRequirements &, const memory_usage_t,
+                            const resource_tiling_t);
+  void free(gpu_allocation_t &);
+
+  // create the resource and bind it to a fresh allocation
+  gpu_allocation_t create_buffer(const VkBufferCreateInfo &,
+                                 const memory_usage_t, VkBuffer &);
+  gpu_allocation_t create_image(const VkImageCreateInfo &,
+                                const memory_usage_t, VkImage &);
+
+  void destroy_buffer(VkBuffer, gpu_allocation_t &);
+  void destroy_image(VkImage, gpu_allocation_t &);
+
+  gpu_memory_stats_t stats() const;
+
+private:
+  // aborts when no memory type accepts the resource
+  uint32_t find_memory_type(const uint32_t, const memory_usage_t) const;
+
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memory_properties = {};
+  VkDeviceSize block_size;
+  VkDeviceSize buffer_image_granularity;
+  VkDeviceSize non_coherent_atom_size;
+  uint32_t max_device_allocations;
+
+  mutable std::mutex mutex;
+  std::array<std::vector<std::unique_ptr<gpu_block_t>>,
+             static_cast<size_t>(memory_usage_t::count)>
+      pools;
+};
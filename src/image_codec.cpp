@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+
+#include "image_codec.hpp"
+
+namespace {
+struct rgb_t {
+  uint8_t r = 0, g = 0, b = 0;
+  bool operator==(const rgb_t &) const = default;
+};
+
+rgb_t load_rgb(const image_view_t &image, const size_t texel) {
+  const auto *data = reinterpret_cast<const uint8_t *>(image.texels.data()) +
+                     texel * image.channels;
+  return image.bgra ? rgb_t{data[2], data[1], data[0]}
+                    : rgb_t{data[0], data[1], data[2]};
+}
+
+void put_u8(std::vector<std::byte> &out, const uint32_t value) {
+  out.push_back(static_cast<std::byte>(value));
+}
+
+void put_be32(std::vector<std::byte> &out, const uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    put_u8(out, value >> shift);
+}
+
+void put_le16(std::vector<std::byte> &out, const uint32_t value) {
+  put_u8(out, value);
+  put_u8(out, value >> 8);
+}
+
+constexpr std::array<uint32_t, 256> crc_table = [] {
+  std::array<uint32_t, 256> table = {};
+  for (uint32_t index = 0; index < 256; index += 1) {
+    uint32_t crc = index;
+    for (int bit = 0; bit < 8; bit += 1)
+      crc = crc & 1 ? 0xedb8'8320u ^ (crc >> 1) : crc >> 1;
+    table[index] = crc;
+  }
+  return table;
+}();
+
+uint32_t crc32(const std::span<const std::byte> data) {
+  uint32_t crc = 0xffff'ffffu;
+  for (const auto byte : data)
+    crc = crc_table[(crc ^ static_cast<uint8_t>(byte)) & 0xff] ^ (crc >> 8);
+  return crc ^ 0xffff'ffffu;
+}
+
+// length, type and data are written by the caller, the crc covers the type
+// and data after the length field
+void end_chunk(std::vector<std::byte> &out, const size_t chunk_start) {
+  const auto crc = crc32(std::span{out}.subspan(chunk_start + 4));
+  put_be32(out, crc);
+}
+
+void begin_chunk(std::vector<std::byte> &out, const uint32_t size,
+                 const char (&type)[5]) {
+  put_be32(out, size);
+  for (int index = 0; index < 4; index += 1)
+    put_u8(out, static_cast<uint8_t>(type[index]));
+}
+} // namespace
+
+void encode_png(const image_view_t &image, std::vector<std::byte> &out) {
+  constexpr uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  constexpr size_t max_block = 65535;
+
+  const size_t row_size = 1 + size_t{image.width} * 3; // filter byte first
+  const size_t raw_size = row_size * image.height;
+  const size_t blocks =
+      raw_size == 0 ? 1 : (raw_size + max_block - 1) / max_block;
+
+  for (const auto byte : signature)
+    put_u8(out, byte);
+
+  {
+    const auto start = out.size();
+    begin_chunk(out, 13, "IHDR");
+    put_be32(out, image.width);
+    put_be32(out, image.height);
+    put_u8(out, 8); // bit depth
+    put_u8(out, 2); // truecolor
+    put_u8(out, 0); // deflate
+    put_u8(out, 0); // adaptive filtering
+    put_u8(out, 0); // no interlace
+    end_chunk(out, start);
+  }
+
+  // zlib header, stored blocks and the adler32 of the filtered rows
+  const auto idat_size = 2 + blocks * 5 + raw_size + 4;
+  const auto start = out.size();
+  begin_chunk(out, static_cast<uint32_t>(idat_size), "IDAT");
+  out.reserve(out.size() + idat_size + 16);
+  put_u8(out, 0x78);
+  put_u8(out, 0x01);
+
+  uint32_t adler_a = 1, adler_b = 0;
+  size_t written = 0, block_left = 0;
+  const auto emit = [&](const uint8_t value) {
+    if (block_left == 0) {
+      block_left = std::min(raw_size - written, max_block);
+      put_u8(out, written + block_left == raw_size ? 1 : 0);
+      put_le16(out, static_cast<uint32_t>(block_left));
+      put_le16(out, static_cast<uint32_t>(~block_left & 0xffff));
+    }
+
+    put_u8(out, value);
+    adler_a = (adler_a + value) % 65521;
+    adler_b = (adler_b + adler_a) % 65521;
+    block_left -= 1;
+    written += 1;
+  };
+
+  for (uint32_t y = 0; y < image.height; y += 1) {
+    emit(0); // no filter
+
+    const size_t row = size_t{y} * image.width;
+    for (uint32_t x = 0; x < image.width; x += 1) {
+      const auto texel = load_rgb(image, row + x);
+      emit(texel.r);
+      emit(texel.g);
+      emit(texel.b);
+    }
+  }
+
+  // an empty image still needs one final block
+  if (raw_size == 0) {
+    put_u8(out, 1);
+    put_le16(out, 0);
+    put_le16(out, 0xffff);
+  }
+
+  put_be32(out, (adler_b << 16) | adler_a);
+  end_chunk(out, start);
+
+  begin_chunk(out, 0, "IEND");
+  end_chunk(out, out.size() - 8);
+}
+
+void encode_qoi(const image_view_t &image, std::vector<std::byte> &out) {
+  constexpr uint8_t op_index = 0x00, op_diff = 0x40, op_luma = 0x80,
+                    op_run = 0xc0, op_rgb = 0xfe;
+
+  for (const auto byte : {'q', 'o', 'i', 'f'})
+    put_u8(out, static_cast<uint8_t>(byte));
+  put_be32(out, image.width);
+  put_be32(out, image.height);
+  put_u8(out, 3); // rgb
+  put_u8(out, 0); // srgb with linear alpha
+
+  // the decoder starts with transparent black everywhere, which no opaque
+  // texel can match, so slots only count once written
+  std::array<std::optional<rgb_t>, 64> seen = {};
+  rgb_t previous = {};
+  uint32_t run = 0;
+
+  const size_t texels = size_t{image.width} * image.height;
+  out.reserve(out.size() + texels * 4 + 8);
+
+  for (size_t texel = 0; texel < texels; texel += 1) {
+    const auto current = load_rgb(image, texel);
+
+    if (current == previous) {
+      run += 1;
+      if (run == 62 || texel + 1 == texels) {
+        put_u8(out, op_run | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+
+    if (run > 0) {
+      put_u8(out, op_run | (run - 1));
+      run = 0;
+    }
+
+    // alpha is always opaque so it drops out of the hash as a constant
+    const auto hash = (current.r * 3 + current.g * 5 + current.b * 7 +
+                       255 * 11) % 64;
+
+    if (seen[hash] == current) {
+      put_u8(out, op_index | hash);
+    } else {
+      seen[hash] = current;
+
+      const auto dr = static_cast<int8_t>(current.r - previous.r);
+      const auto dg = static_cast<int8_t>(current.g - previous.g);
+      const auto db = static_cast<int8_t>(current.b - previous.b);
+      const auto dr_dg = dr - dg, db_dg = db - dg;
+
+      if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+        put_u8(out, op_diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+      } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                 db_dg >= -8 && db_dg <= 7) {
+        put_u8(out, op_luma | (dg + 32));
+        put_u8(out, (dr_dg + 8) << 4 | (db_dg + 8));
+      } else {
+        put_u8(out, op_rgb);
+        put_u8(out, current.r);
+        put_u8(out, current.g);
+        put_u8(out, current.b);
+      }
+    }
+
+    previous = current;
+  }
+
+  for (int index = 0; index < 7; index += 1)
+    put_u8(out, 0);
+  put_u8(out, 1);
+}
+
+void convert_yuv420(const image_view_t &image, std::vector<std::byte> &out) {
+  const size_t width = image.width, height = image.height;
+  const size_t chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+
+  const auto luma_start = out.size();
+  out.resize(luma_start + width * height + 2 * chroma_width * chroma_height);
+
+  auto *luma = reinterpret_cast<uint8_t *>(out.data() + luma_start);
+  auto *u_plane = luma + width * height;
+  auto *v_plane = u_plane + chroma_width * chroma_height;
+
+  // 8 bit fixed point bt.601 coefficients
+  for (size_t y = 0; y < height; y += 1)
+    for (size_t x = 0; x < width; x += 1) {
+      const auto texel = load_rgb(image, y * width + x);
+      luma[y * width + x] = static_cast<uint8_t>(
+          (77 * texel.r + 150 * texel.g + 29 * texel.b + 128) >> 8);
+    }
+
+  for (size_t cy = 0; cy < chroma_height; cy += 1)
+    for (size_t cx = 0; cx < chroma_width; cx += 1) {
+      int r = 0, g = 0, b = 0, samples = 0;
+      for (size_t y = 2 * cy; y < std::min(2 * cy + 2, height); y += 1)
+        for (size_t x = 2 * cx; x < std::min(2 * cx + 2, width); x += 1) {
+          const auto texel = load_rgb(image, y * width + x);
+          r += texel.r;
+          g += texel.g;
+          b += texel.b;
+          samples += 1;
+        }
+
+      r /= samples;
+      g /= samples;
+      b /= samples;
+
+      const auto chroma = cy * chroma_width + cx;
+      u_plane[chroma] =
+          static_cast<uint8_t>(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+      v_plane[chroma] =
+          static_cast<uint8_t>(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// 8 bit texels, tightly packed rows, alpha is not encoded
+struct image_view_t {
+  uint32_t width = 0, height = 0;
+  uint32_t channels = 4; // 3 for packed rgb
+  bool bgra = false;     // blue first, as swapchain formats usually are
+  std::span<const std::byte> texels = {};
+};
+
+// encoders append to out, which callers reuse between frames so steady state
+// encoding does not allocate
+
+// rgb png with stored deflate blocks, trades file size for encoding at memcpy
+// speed without a zlib dependency
+void encode_png(const image_view_t &, std::vector<std::byte> &out);
+
+// rgb qoi, lossless and typically within a few percent of png sizes
+void encode_qoi(const image_view_t &, std::vector<std::byte> &out);
+
+// full range bt.601 4:2:0 planes, y then u then v, chroma planes are
+// ceil(width / 2) by ceil(height / 2) and average 2x2 blocks
+void convert_yuv420(const image_view_t &, std::vector<std::byte> &out);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+// per instance vertex attributes, bound at VK_VERTEX_INPUT_RATE_INSTANCE,
+// filled in by transform_system_t
+struct instance_t {
+  float model[4] = {};   // column major 2x2 rotation and scale
+  float offset[2] = {};  // translation
+  uint32_t color = 0;    // rgba8 unorm, tints the vertex colors
+  uint32_t material = 0; // material id
+};
+
+constexpr uint32_t instance_binding = 1;
+
+constexpr VkVertexInputBindingDescription instance_binding_description = {
+    .binding = instance_binding,
+    .stride = sizeof(instance_t),
+    .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+};
+
+constexpr VkVertexInputAttributeDescription instance_attributes[] = {
+    {1, instance_binding, VK_FORMAT_R32G32B32A32_SFLOAT,
+     offsetof(instance_t, model)},
+    {2, instance_binding, VK_FORMAT_R32G32_SFLOAT,
+     offsetof(instance_t, offset)},
+    {3, instance_binding, VK_FORMAT_R8G8B8A8_UNORM,
+     offsetof(instance_t, color)},
+    {4, instance_binding, VK_FORMAT_R32_UINT, offsetof(instance_t, material)},
+};
+
+// view of the 2d scene, pushed to the vertex shader ahead of any other push
+// constants
+//
+// the tile transform magnifies part of clip space onto the whole target, it
+// is the identity unless rendering tiles of a larger image
+struct camera_t {
+  float center[2] = {};
+  float zoom = 1.0f;    // clip space units per world unit
+  float padding = 0.0f; // vec4 in glsl
+  float tile_offset[2] = {};
+  float tile_scale[2] = {1.0f, 1.0f};
+};
@@ -0,0 +1,217 @@
+#include <algorithm>
+
+#include "globals.hpp"
+
+#include "job_system.hpp"
+
+struct job_t {
+  job_system_t::job_fn_t fn = {};
+
+  // unfinished jobs it runs after, plus one held while it is submitted
+  std::atomic<uint32_t> blockers = 1;
+  std::atomic<bool> done = false;
+
+  std::mutex mutex; // orders done against new dependents
+  std::vector<job_handle_t> dependents = {};
+};
+
+namespace {
+
+// the system the calling thread works for and its slot there
+thread_local const job_system_t *current_system = nullptr;
+thread_local uint32_t current_thread = 0;
+
+} // namespace
+
+job_system_t::job_system_t(const uint32_t worker_count)
+    : worker_count{std::max(worker_count, 1u)},
+      queues{std::make_unique<queue_t[]>(this->worker_count + 1)} {
+  workers.reserve(this->worker_count);
+  for (uint32_t thread = 1; thread <= this->worker_count; thread += 1)
+    workers.emplace_back(&job_system_t::worker_loop, this, thread);
+}
+
+job_system_t::~job_system_t() {
+  {
+    const std::scoped_lock lock{sleep_mutex};
+    stopping = true;
+  }
+
+  wake.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+uint32_t job_system_t::thread_index() const {
+  return current_system == this ? current_thread : 0;
+}
+
+job_handle_t job_system_t::submit(job_fn_t fn,
+                                  std::span<const job_handle_t> after) {
+  auto job = std::make_shared<job_t>();
+  job->fn = std::move(fn);
+
+  for (const auto &dependency : after) {
+    if (!dependency)
+      continue;
+
+    const std::scoped_lock lock{dependency->mutex};
+    if (dependency->done.load(std::memory_order_relaxed))
+      continue;
+
+    job->blockers.fetch_add(1, std::memory_order_relaxed);
+    dependency->dependents.push_back(job);
+  }
+
+  release(job);
+  return job;
+}
+
+void job_system_t::submit_background(job_fn_t fn) {
+  auto job = std::make_shared<job_t>();
+  job->fn = std::move(fn);
+
+  queued.fetch_add(1);
+  {
+    const std::scoped_lock lock{background.mutex};
+    background.jobs.push_back(std::move(job));
+  }
+
+  notify();
+}
+
+void job_system_t::wait(const job_handle_t &job) {
+  if (!job)
+    return;
+
+  // help out, and only sleep once there is nothing left to run here
+  const auto thread = thread_index();
+  while (!job->done.load(std::memory_order_acquire))
+    if (!run_one(thread, false))
+      job->done.wait(false, std::memory_order_acquire);
+}
+
+void job_system_t::wait(std::span<const job_handle_t> jobs) {
+  for (const auto &job : jobs)
+    wait(job);
+}
+
+bool job_system_t::finished(const job_handle_t &job) const {
+  return !job || job->done.load(std::memory_order_acquire);
+}
+
+void job_system_t::parallel_for(const uint32_t count, const uint32_t grain,
+                                const range_fn_t &fn) {
+  ASSERT(grain > 0);
+  if (count == 0)
+    return;
+
+  const auto chunks = (count + grain - 1) / grain;
+
+  std::vector<job_handle_t> jobs = {};
+  jobs.reserve(chunks - 1);
+  for (uint32_t chunk = 1; chunk < chunks; chunk += 1) {
+    const auto first = chunk * grain;
+    const auto length = std::min(grain, count - first);
+    jobs.push_back(submit([&fn, first, length] { fn(first, length); }));
+  }
+
+  fn(0, std::min(grain, count));
+  wait(jobs);
+}
+
+void job_system_t::push(job_handle_t job) {
+  // counted first so it never drops below what is actually queued
+  queued.fetch_add(1);
+
+  auto &queue = queues[thread_index()];
+  {
+    const std::scoped_lock lock{queue.mutex};
+    queue.jobs.push_back(std::move(job));
+  }
+
+  notify();
+}
+
+void job_system_t::notify() {
+  // a worker checks queued under the lock before sleeping, taking it here
+  // means it has either seen the new job or is already waiting
+  { const std::scoped_lock lock{sleep_mutex}; }
+  wake.notify_one();
+}
+
+void job_system_t::release(const job_handle_t &job) {
+  if (job->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    push(job);
+}
+
+void job_system_t::run(const job_handle_t &job) {
+  job->fn();
+  job->fn = {}; // drop captures before anyone waiting returns
+
+  std::vector<job_handle_t> dependents = {};
+  {
+    const std::scoped_lock lock{job->mutex};
+    job->done.store(true, std::memory_order_release);
+    dependents.swap(job->dependents);
+  }
+
+  job->done.notify_all();
+  for (const auto &dependent : dependents)
+    release(dependent);
+}
+
+bool job_system_t::run_one(const uint32_t thread, const bool background) {
+  job_handle_t job = {};
+
+  // newest of our own first, it is likely still in cache
+  {
+    auto &own = queues[thread];
+    const std::scoped_lock lock{own.mutex};
+    if (!own.jobs.empty()) {
+      job = std::move(own.jobs.back());
+      own.jobs.pop_back();
+    }
+  }
+
+  // then the oldest of everyone else's, starting past ourselves so thieves
+  // spread out
+  for (uint32_t offset = 1; !job && offset <= worker_count; offset += 1) {
+    auto &victim = queues[(thread + offset) % (worker_count + 1)];
+    const std::scoped_lock lock{victim.mutex};
+    if (!victim.jobs.empty()) {
+      job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+    }
+  }
+
+  if (!job && background) {
+    const std::scoped_lock lock{this->background.mutex};
+    if (!this->background.jobs.empty()) {
+      job = std::move(this->background.jobs.front());
+      this->background.jobs.pop_front();
+    }
+  }
+
+  if (!job)
+    return false;
+
+  queued.fetch_sub(1);
+  run(job);
+  return true;
+}
+
+void job_system_t::worker_loop(const uint32_t thread) {
+  current_system = this;
+  current_thread = thread;
+
+  while (true) {
+    if (run_one(thread, true))
+      continue;
+
+    std::unique_lock lock{sleep_mutex};
+    wake.wait(lock, [this] { return stopping || queued.load() != 0; });
+    if (stopping && queued.load() == 0)
+      return;
+  }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+struct job_t;
+using job_handle_t = std::shared_ptr<job_t>;
+
+// work stealing job system shared by startup and per frame work
+//
+// every thread has a deque of runnable jobs, the owner pushes and pops at the
+// back while idle threads steal from the front of the others, threads outside
+// the system share deque 0 and help run jobs while they wait() on one
+//
+// a job only becomes runnable once every job it was submitted after has run,
+// background jobs run on the workers alone, after everything else, so a long
+// pipeline compile never stalls a thread waiting on frame work
+class job_system_t {
+public:
+  using job_fn_t = std::function<void()>;
+  using range_fn_t = std::function<void(const uint32_t, const uint32_t)>;
+
+  explicit job_system_t(const uint32_t worker_count);
+
+  // queued jobs are run before the workers exit
+  ~job_system_t();
+
+  job_system_t(const job_system_t &) = delete;
+  job_system_t &operator=(const job_system_t &) = delete;
+
+  // workers plus the threads outside the system, sharing slot 0
+  uint32_t threads() const { return worker_count + 1; }
+
+  // slot of the calling thread in [0, threads()), 0 outside the system
+  uint32_t thread_index() const;
+
+  // runs once every job in after has, null handles are ignored
+  job_handle_t submit(job_fn_t, std::span<const job_handle_t> after = {});
+  void submit_background(job_fn_t);
+
+  // runs other jobs until the job has, returns at once for a null handle
+  void wait(const job_handle_t &);
+  void wait(std::span<const job_handle_t>);
+  bool finished(const job_handle_t &) const;
+
+  // fn(first, count) over [0, count) in chunks of at most grain, the calling
+  // thread takes the first chunk and returns once all of them have run
+  void parallel_for(const uint32_t count, const uint32_t grain,
+                    const range_fn_t &);
+
+private:
+  struct queue_t {
+    std::mutex mutex;
+    std::deque<job_handle_t> jobs = {};
+  };
+
+  void push(job_handle_t);
+  void notify();
+  void release(const job_handle_t &);
+  void run(const job_handle_t &);
+  bool run_one(const uint32_t thread, const bool background);
+  void worker_loop(const uint32_t thread);
+
+  const uint32_t worker_count;
+
+  // [thread_index()]
+  std::unique_ptr<queue_t[]> queues;
+  queue_t background = {};
+  std::atomic<uint32_t> queued = 0; // runnable jobs in any queue
+
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+
+  std::vector<std::thread> workers = {};
+};
@@ -1,9 +1,236 @@
+#include <charconv>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
 #include "globals.hpp"
 
 #include "application.hpp"
+#include "capture.hpp"
+#include "pipeline_state.hpp"
+#include "tiling.hpp"
+
+int main(int argc, char **argv) {
+  chungus_config_t config = {};
+  capture_options_t capture_options = {};
+  std::string_view tiled_output = "tiled.ppm";
+
+  const auto parse_number = [](const std::string_view value, auto &out) {
+    const auto [end, error] =
+        std::from_chars(value.data(), value.data() + value.size(), out);
+    return error == std::errc{} && end == value.data() + value.size();
+  };
+
+  // x,y,w,h
+  const auto parse_rect = [&](std::string_view value, VkRect2D &out) {
+    uint32_t fields[4] = {};
+    for (auto &field : fields) {
+      const auto end = value.find(',');
+      if (!parse_number(value.substr(0, end), field))
+        return false;
+      value = end == std::string_view::npos ? "" : value.substr(end + 1);
+    }
+
+    out = {{static_cast<int32_t>(fields[0]), static_cast<int32_t>(fields[1])},
+           {fields[2], fields[3]}};
+    return value.empty();
+  };
+
+  // wxh
+  const auto parse_size = [&](const std::string_view value) {
+    const auto split = value.find('x');
+    return split != std::string_view::npos &&
+           parse_number(value.substr(0, split), config.tiled_width) &&
+           parse_number(value.substr(split + 1), config.tiled_height) &&
+           config.tiled_width > 0 && config.tiled_height > 0;
+  };
+
+  for (int index = 1; index < argc; index += 1) {
+    const std::string_view arg{argv[index]};
+    const std::string_view value = index + 1 < argc ? argv[index + 1] : "";
+
+    if (arg == "--headless") {
+      config.headless = true;
+    } else if (arg == "--frames" && parse_number(value, config.frame_count)) {
+      index += 1;
+    } else if (arg == "--warmup" && parse_number(value, config.warmup_frames)) {
+      index += 1;
+    } else if (arg == "--instances" &&
+               parse_number(value, config.instance_count) &&
+               config.instance_count > 0) {
+      index += 1;
+    } else if (arg == "--draws" &&
+               parse_number(value, config.draws_per_frame) &&
+               config.draws_per_frame > 0) {
+      index += 1;
+    } else if (arg == "--frames-in-flight" &&
+               parse_number(value, config.frames_in_flight) &&
+               config.frames_in_flight > 0) {
+      index += 1;
+    } else if (arg == "--no-gpu-culling") {
+      config.gpu_culling = false;
+    } else if (arg == "--zoom" && parse_number(value, config.zoom) &&
+               config.zoom > 0.0f) {
+      index += 1;
+    } else if (arg == "--no-async-queues") {
+      config.async_queues = false;
+    } else if (arg == "--animate" &&
+               parse_number(value, config.animated_instances)) {
+      index += 1;
+    } else if (arg == "--worker-threads" &&
+               parse_number(value, config.worker_threads)) {
+      index += 1;
+    } else if (arg == "--width" && parse_number(value, config.width) &&
+               config.width > 0) {
+      index += 1;
+    } else if (arg == "--height" && parse_number(value, config.height) &&
+               config.height > 0) {
+      index += 1;
+    } else if (arg == "--pacing" && parse_pacing_mode(value, config.pacing)) {
+      index += 1;
+    } else if (arg == "--fps" && parse_number(value, config.frame_rate_limit) &&
+               config.frame_rate_limit > 0) {
+      config.pacing = pacing_mode_t::limited;
+      index += 1;
+    } else if (arg == "--timings") {
+      config.print_timings = true;
+    } else if (arg == "--timings-interval" &&
+               parse_number(value, config.timing_report_interval)) {
+      index += 1;
+    } else if (arg == "--mesh" && !value.empty()) {
+      config.mesh_path = value;
+      index += 1;
+    } else if (arg == "--texture" && !value.empty()) {
+      config.texture_paths.push_back(value);
+      index += 1;
+    } else if (arg == "--texture-budget" &&
+               parse_number(value, config.texture_budget) &&
+               config.texture_budget > 0) {
+      config.texture_budget <<= 20;
+      index += 1;
+    } else if (arg == "--capture" && !value.empty()) {
+      capture_options.directory = value;
+      index += 1;
+    } else if (arg == "--capture-format" &&
+               parse_capture_format(value, capture_options.format)) {
+      index += 1;
+    } else if (arg == "--capture-threads" &&
+               parse_number(value, capture_options.threads)) {
+      index += 1;
+    } else if (arg == "--capture-scale" &&
+               parse_number(value, config.readback_scale) &&
+               config.readback_scale > 0) {
+      index += 1;
+    } else if (arg == "--capture-crop" &&
+               parse_rect(value, config.readback_crop)) {
+      index += 1;
+    } else if (arg == "--capture-depth" &&
+               parse_number(value, capture_options.queue_depth) &&
+               capture_options.queue_depth > 0) {
+      index += 1;
+    } else if (arg == "--tiled" && parse_size(value)) {
+      config.headless = true;
+      index += 1;
+    } else if (arg == "--tiled-output" && !value.empty()) {
+      tiled_output = value;
+      index += 1;
+    } else if (arg == "--device" && !value.empty()) {
+      config.device_name = value;
+      index += 1;
+    } else if (arg == "--memory-stats") {
+      config.print_memory_stats = true;
+    } else if (arg == "--pipeline-cache" && !value.empty()) {
+      config.pipeline_cache_path = value;
+      index += 1;
+    } else if (arg == "--no-pipeline-cache") {
+      config.pipeline_cache_path = {};
+    } else if (arg == "--variant" && find_variant(scene_variants, value)) {
+      config.pipeline_variant = value;
+      index += 1;
+    } else if (arg == "--watch-shaders" && !value.empty()) {
+      config.shader_watch_dir = value;
+      index += 1;
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--headless] [--frames n] [--warmup n] [--instances n]"
+                   " [--draws n] [--worker-threads n] [--animate n]"
+                   " [--frames-in-flight n] [--no-async-queues]"
+                   " [--no-gpu-culling] [--zoom f] [--mesh file.cmesh]"
+                   " [--texture file.ctex] [--texture-budget mib]"
+                   " [--width n] [--height n]"
+                   " [--pacing vsync|limited|uncapped] [--fps n]"
+                   " [--timings] [--timings-interval n]"
+                   " [--capture dir] [--capture-format png|qoi|y4m]"
+                   " [--capture-threads n] [--capture-depth n]"
+                   " [--capture-scale n] [--capture-crop x,y,w,h]"
+                   " [--tiled wxh] [--tiled-output file.ppm]"
+                   " [--device name] [--memory-stats]"
+                   " [--pipeline-cache path] [--no-pipeline-cache]"
+                   " [--variant default|untextured|uv|additive|unculled]"
+                   " [--watch-shaders build/generated/shaders]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // there is no window to close, a signal would skip saving the pipeline cache
+  // and finishing the capture
+  if (config.headless && config.frame_count == 0 && config.tiled_width == 0) {
+    std::cerr << "--headless needs --frames or --tiled" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // frames are encoded off the render thread, and dropped when it falls behind
+  std::optional<capture_writer_t> capture;
+  if (!capture_options.directory.empty()) {
+    capture_options.frame_rate = config.frame_rate_limit;
+    capture.emplace(capture_options);
+    config.readback_layout = capture->readback_layout();
+    config.readback_callback = [&capture](const readback_frame_t &frame) {
+      capture->submit(frame);
+    };
+  }
+
+  // tiles need every frame at full size, which capture cannot promise
+  const bool tiled = config.tiled_width != 0;
+  if (tiled && capture) {
+    std::cerr << "--tiled cannot be combined with --capture" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const bool cropped = config.readback_crop.extent.width != 0 ||
+                       config.readback_crop.extent.height != 0;
+  if (tiled && (config.readback_scale != 1 || cropped)) {
+    std::cerr << "--tiled cannot be combined with --capture-scale or "
+                 "--capture-crop"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // each frame renders the next tile, streamed out a band of tiles at a time
+  std::optional<tile_writer_t> tile_writer;
+  if (tiled) {
+    tile_writer.emplace(tiled_output,
+                        VkExtent2D{config.tiled_width, config.tiled_height});
+    config.readback_layout = readback_layout_t::rgb8;
+    config.readback_callback = [&tile_writer](const readback_frame_t &frame) {
+      tile_writer->write(frame);
+    };
+  }
+
+  {
+    const chungus_application app{config};
+  }
+
+  if (tile_writer && !tile_writer->complete()) {
+    std::cerr << "tiles: " << tiled_output << " is incomplete" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (capture) {
+    capture->finish();
+    capture->stats().print(std::cout);
+  }
 
-int main() {
-  const auto width = 800, height = 600;
-  const chungus_application app{height, width, "chungus"};
   return 0;
 }
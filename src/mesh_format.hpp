@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// .cmesh, little endian binary meshes that are used exactly as stored
+//
+//   cmesh_header_t                       64 bytes
+//   vertices at vertex_offset            vertex_count * vertex_stride bytes
+//   indices at index_offset              index_count * index_size bytes
+//
+// both blobs start on a cmesh_alignment boundary so they can be copied
+// straight out of a memory mapping, see tools/obj_to_cmesh.cpp
+constexpr uint32_t cmesh_magic = 0x6873'6d63; // "cmsh"
+constexpr uint32_t cmesh_version = 1;
+constexpr uint64_t cmesh_alignment = 64;
+
+struct cmesh_header_t {
+  uint32_t magic = cmesh_magic;
+  uint32_t version = cmesh_version;
+  uint32_t vertex_stride = 0; // bytes, xy float positions
+  uint32_t index_size = 0;    // 2 or 4 bytes
+  uint64_t vertex_count = 0;
+  uint64_t index_count = 0;   // triangle list
+  uint64_t vertex_offset = 0; // from the start of the file
+  uint64_t index_offset = 0;
+  float radius = 0.0f; // farthest vertex from the origin
+  uint32_t reserved[3] = {};
+};
+
+static_assert(sizeof(cmesh_header_t) == 64);
+
+constexpr uint64_t cmesh_align(const uint64_t offset) {
+  return (offset + cmesh_alignment - 1) & ~(cmesh_alignment - 1);
+}
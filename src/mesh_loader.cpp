@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "globals.hpp"
+
+#include "mesh_loader.hpp"
+
+namespace {
+
+// why the header cannot be used, null when it can
+const char *check_header(const cmesh_header_t &header, const size_t size) {
+  if (header.magic != cmesh_magic)
+    return "not a cmesh file";
+
+  if (header.version != cmesh_version)
+    return "unsupported version";
+
+  if (header.vertex_stride != 2 * sizeof(float))
+    return "unsupported vertex layout";
+
+  if (header.index_size != 2 && header.index_size != 4)
+    return "unsupported index size";
+
+  if (header.vertex_count == 0 || header.index_count == 0)
+    return "empty mesh";
+
+  if (header.index_count % 3 != 0 || header.index_count > UINT32_MAX)
+    return "bad index count";
+
+  // feeds the cull bounds, nan or negative would cull everything or nothing
+  if (!std::isfinite(header.radius) || header.radius < 0.0f)
+    return "bad radius";
+
+  if (header.vertex_offset % cmesh_alignment != 0 ||
+      header.index_offset % cmesh_alignment != 0)
+    return "misaligned blobs";
+
+  // counts are checked by division so huge values cannot overflow
+  const auto fits = [&](const uint64_t offset, const uint64_t count,
+                        const uint64_t stride) {
+    return offset <= size && count <= (size - offset) / stride;
+  };
+
+  if (!fits(header.vertex_offset, header.vertex_count, header.vertex_stride) ||
+      !fits(header.index_offset, header.index_count, header.index_size))
+    return "truncated";
+
+  return nullptr;
+}
+
+// robustBufferAccess is off, an index past the vertices reads whatever
+// memory lies beyond them
+template <typename index_t>
+bool indices_in_range(const mapped_mesh_t &mesh) {
+  const auto bytes = mesh.indices();
+  const std::span indices{reinterpret_cast<const index_t *>(bytes.data()),
+                          bytes.size() / sizeof(index_t)};
+  const auto vertex_count = mesh.header().vertex_count;
+  return std::all_of(indices.begin(), indices.end(), [&](const auto index) {
+    return index < vertex_count;
+  });
+}
+
+} // namespace
+
+mapped_mesh_t::mapped_mesh_t(const std::byte *data, const size_t size)
+    : data{data}, size{size} {}
+
+mapped_mesh_t::~mapped_mesh_t() {
+  munmap(const_cast<std::byte *>(data), size);
+}
+
+const cmesh_header_t &mapped_mesh_t::header() const {
+  return *reinterpret_cast<const cmesh_header_t *>(data);
+}
+
+std::span<const std::byte> mapped_mesh_t::vertices() const {
+  return {data + header().vertex_offset,
+          header().vertex_count * header().vertex_stride};
+}
+
+std::span<const std::byte> mapped_mesh_t::indices() const {
+  return {data + header().index_offset,
+          header().index_count * header().index_size};
+}
+
+std::unique_ptr<mapped_mesh_t> map_mesh(const std::filesystem::path &path) {
+  const auto fail = [&](const char *reason) {
+    std::cout << "mesh: " << path.string() << ": " << reason << std::endl;
+    return nullptr;
+  };
+
+  const auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return fail("cannot open");
+
+  struct stat info = {};
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(cmesh_header_t)) {
+    close(fd);
+    return fail("too small");
+  }
+
+  const auto size = static_cast<size_t>(info.st_size);
+  auto *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return fail("cannot map");
+
+  // read front to back, indices once more while checking them
+  madvise(data, size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+  auto mesh = std::make_unique<mapped_mesh_t>(
+      static_cast<const std::byte *>(data), size);
+  if (const auto reason = check_header(mesh->header(), size))
+    return fail(reason);
+
+  if (!(mesh->header().index_size == 2 ? indices_in_range<uint16_t>(*mesh)
+                                       : indices_in_range<uint32_t>(*mesh)))
+    return fail("index out of range");
+
+  return mesh;
+}
+
+mesh_streamer_t::mesh_streamer_t(const std::filesystem::path &path,
+                                 gpu_allocator_t &allocator,
+                                 upload_context_t &uploads)
+    : path{path}, allocator{allocator}, uploads{uploads} {
+  thread = std::thread{&mesh_streamer_t::run, this};
+}
+
+mesh_streamer_t::~mesh_streamer_t() {
+  thread.join();
+  uploads.wait(ticket);
+
+  if (result.vertex_buffer != VK_NULL_HANDLE)
+    allocator.destroy_buffer(result.vertex_buffer, result.vertex_memory);
+
+  if (result.index_buffer != VK_NULL_HANDLE)
+    allocator.destroy_buffer(result.index_buffer, result.index_memory);
+}
+
+void mesh_streamer_t::run() {
+  const auto start = std::chrono::steady_clock::now();
+
+  const auto mesh = map_mesh(path);
+  if (!mesh) {
+    current.store(state_t::failed, std::memory_order_release);
+    return;
+  }
+
+  const auto &header = mesh->header();
+  const auto vertices = mesh->vertices();
+  const auto indices = mesh->indices();
+
+  {
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    buffer_info.size = vertices.size();
+    buffer_info.usage =
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    result.vertex_memory = allocator.create_buffer(
+        buffer_info, memory_usage_t::gpu_only, result.vertex_buffer);
+
+    buffer_info.size = indices.size();
+    buffer_info.usage =
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    result.index_memory = allocator.create_buffer(
+        buffer_info, memory_usage_t::gpu_only, result.index_buffer);
+  }
+
+  result.index_count = static_cast<uint32_t>(header.index_count);
+  result.index_type = header.index_size == 2 ? VK_INDEX_TYPE_UINT16
+                                             : VK_INDEX_TYPE_UINT32;
+  result.radius = header.radius;
+
+  // chunks keep the staging ring free for other uploads in between, pages
+  // are faulted in by the copy into staging memory
+  for (const auto &[buffer, blob] :
+       {std::pair{result.vertex_buffer, vertices},
+        std::pair{result.index_buffer, indices}}) {
+    for (size_t offset = 0; offset < blob.size(); offset += chunk_size)
+      uploads.upload(buffer, offset,
+                     blob.subspan(offset, std::min(chunk_size,
+                                                   blob.size() - offset)));
+  }
+
+  // only now are both buffers complete, other threads' flushes in between
+  // leave them with the transfer family
+  const std::array finished = {result.vertex_buffer, result.index_buffer};
+  ticket = uploads.flush(finished);
+  current.store(state_t::ready, std::memory_order_release);
+
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "mesh: " << path.string() << ": " << header.vertex_count
+            << " vertices, " << header.index_count << " indices staged in "
+            << elapsed.count() << " ms" << std::endl;
+}
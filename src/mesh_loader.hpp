@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.hpp"
+#include "mesh_format.hpp"
+#include "upload.hpp"
+
+// a .cmesh file mapped read only, the blobs point straight into the mapping
+class mapped_mesh_t {
+public:
+  mapped_mesh_t(const std::byte *data, const size_t size);
+  ~mapped_mesh_t();
+
+  mapped_mesh_t(const mapped_mesh_t &) = delete;
+  mapped_mesh_t &operator=(const mapped_mesh_t &) = delete;
+
+  const cmesh_header_t &header() const;
+  std::span<const std::byte> vertices() const;
+  std::span<const std::byte> indices() const;
+
+private:
+  const std::byte *data;
+  size_t size;
+};
+
+// null when the file cannot be mapped or its header does not check out
+std::unique_ptr<mapped_mesh_t> map_mesh(const std::filesystem::path &);
+
+// device local buffers holding a streamed mesh
+struct gpu_mesh_t {
+  VkBuffer vertex_buffer = {};
+  VkBuffer index_buffer = {};
+  gpu_allocation_t vertex_memory = {};
+  gpu_allocation_t index_memory = {};
+  uint32_t index_count = 0;
+  VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+  float radius = 0.0f; // farthest vertex from the origin
+};
+
+// maps a .cmesh and copies it chunk by chunk from the mapping into the
+// upload context's staging ring on a background thread
+//
+// the buffers are handed over by the final flush, consumers must record the
+// upload context's acquire() before drawing with them
+class mesh_streamer_t {
+public:
+  static constexpr size_t chunk_size = size_t{1} << 20;
+
+  enum class state_t { streaming, ready, failed };
+
+  mesh_streamer_t(const std::filesystem::path &, gpu_allocator_t &,
+                  upload_context_t &);
+
+  // joins the thread and destroys the buffers once their copies complete, the
+  // consumer must be done with them
+  ~mesh_streamer_t();
+
+  mesh_streamer_t(const mesh_streamer_t &) = delete;
+  mesh_streamer_t &operator=(const mesh_streamer_t &) = delete;
+
+  state_t state() const { return current.load(std::memory_order_acquire); }
+
+  // valid once ready
+  const gpu_mesh_t &mesh() const { return result; }
+
+private:
+  void run();
+
+  const std::filesystem::path path;
+  gpu_allocator_t &allocator;
+  upload_context_t &uploads;
+
+  gpu_mesh_t result = {};
+  upload_ticket_t ticket = 0; // of the flush handing the buffers over
+  std::atomic<state_t> current = state_t::streaming;
+  std::thread thread;
+};
@@ -0,0 +1,101 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "globals.hpp"
+
+#include "pipeline_cache.hpp"
+
+namespace {
+
+bool cache_compatible(const std::vector<char> &data,
+                      const VkPhysicalDeviceProperties &properties) {
+  VkPipelineCacheHeaderVersionOne header = {};
+  if (data.size() < sizeof(header))
+    return false;
+
+  std::memcpy(&header, data.data(), sizeof(header));
+  return header.headerSize >= sizeof(header) &&
+         header.headerSize <= data.size() &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                     VK_UUID_SIZE) == 0;
+}
+
+} // namespace
+
+VkPipelineCache
+load_pipeline_cache(VkDevice device,
+                    const VkPhysicalDeviceProperties &properties,
+                    const std::filesystem::path &path) {
+  std::vector<char> data = {};
+  {
+    std::ifstream input{path, std::ios::ate | std::ios::binary};
+    if (input.is_open()) {
+      data.resize(static_cast<size_t>(input.tellg()));
+      input.seekg(0);
+      input.read(data.data(), data.size());
+
+      if (!input)
+        data.clear();
+    }
+  }
+
+  if (!data.empty() && !cache_compatible(data, properties)) {
+    std::cout << "pipeline cache: " << path.string()
+              << " is from another device or driver, ignoring" << std::endl;
+    data.clear();
+  }
+
+  VkPipelineCacheCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  create_info.initialDataSize = data.size();
+  create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+  VkPipelineCache cache = {};
+  VK_CALL(vkCreatePipelineCache(device, &create_info, nullptr, &cache));
+
+  if (!data.empty())
+    std::cout << "pipeline cache: loaded " << data.size() << " bytes"
+              << std::endl;
+
+  return cache;
+}
+
+void save_pipeline_cache(VkDevice device, VkPipelineCache cache,
+                         const std::filesystem::path &path) {
+  size_t size = 0;
+  VK_CALL(vkGetPipelineCacheData(device, cache, &size, nullptr));
+
+  std::vector<char> data(size);
+  VK_CALL(vkGetPipelineCacheData(device, cache, &size, data.data()));
+  data.resize(size);
+
+  // write next to the destination then rename over it
+  auto temp_path = path;
+  temp_path += ".tmp";
+  {
+    std::ofstream output{temp_path, std::ios::binary | std::ios::trunc};
+    output.write(data.data(), data.size());
+    output.close();
+
+    if (!output) {
+      std::cout << "pipeline cache: failed to write " << temp_path.string()
+                << std::endl;
+      std::error_code error = {};
+      std::filesystem::remove(temp_path, error);
+      return;
+    }
+  }
+
+  std::error_code error = {};
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    std::cout << "pipeline cache: failed to replace " << path.string() << ": "
+              << error.message() << std::endl;
+    std::filesystem::remove(temp_path, error);
+  }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <filesystem>
+
+#include <vulkan/vulkan.h>
+
+// create a pipeline cache seeded from disk, data written by another driver or
+// device is dropped and an empty cache is created instead
+VkPipelineCache load_pipeline_cache(VkDevice,
+                                    const VkPhysicalDeviceProperties &,
+                                    const std::filesystem::path &);
+
+// write the cache contents to disk, replaces the file atomically so readers
+// never observe a partial cache
+void save_pipeline_cache(VkDevice, VkPipelineCache,
+                         const std::filesystem::path &);
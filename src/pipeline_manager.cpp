@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string_view>
+
+#include "globals.hpp"
+
+#include "pipeline_manager.hpp"
+#include "shader_registry.hpp"
+
+namespace {
+
+constexpr uint32_t spirv_magic = 0x0723'0203;
+
+// the words of a glslangValidator -x output, empty when it does not parse,
+// eg: while the build is still writing it
+std::vector<uint32_t> read_spirv_words(const std::filesystem::path &path) {
+  std::ifstream input{path};
+  const std::string text{std::istreambuf_iterator<char>{input}, {}};
+
+  std::vector<uint32_t> words = {};
+  for (auto at = text.find("0x"); at != std::string::npos;
+       at = text.find("0x", at)) {
+    uint32_t word = 0;
+    const auto *begin = text.data() + at + 2;
+    const auto [end, error] =
+        std::from_chars(begin, text.data() + text.size(), word, 16);
+    if (error != std::errc{})
+      return {};
+
+    words.push_back(word);
+    at = static_cast<size_t>(end - text.data());
+  }
+
+  if (words.size() < 5 || words[0] != spirv_magic)
+    return {};
+
+  return words;
+}
+
+VkShaderStageFlagBits shader_stage(const std::string_view name) {
+  if (name.ends_with(".vert"))
+    return VK_SHADER_STAGE_VERTEX_BIT;
+  if (name.ends_with(".frag"))
+    return VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  ASSERT(name.ends_with(".comp"));
+  return VK_SHADER_STAGE_COMPUTE_BIT;
+}
+
+} // namespace
+
+pipeline_manager_t::pipeline_manager_t(VkDevice device, job_system_t &jobs,
+                                       const std::filesystem::path &shader_dir)
+    : device{device}, jobs{jobs}, shader_dir{shader_dir} {}
+
+pipeline_manager_t::~pipeline_manager_t() {
+  {
+    std::unique_lock lock{mutex};
+    stopping = true;
+    idle.wait(lock, [this] { return outstanding == 0; });
+  }
+
+  for (const auto &result : results)
+    vkDestroyPipeline(device, result.pipeline, nullptr);
+
+  for (const auto &[pipeline, _] : retired)
+    vkDestroyPipeline(device, pipeline, nullptr);
+
+  for (const auto &slot : slots)
+    vkDestroyPipeline(device, slot.pipeline, nullptr);
+}
+
+pipeline_handle_t pipeline_manager_t::create(pipeline_recipe_t recipe) {
+  const auto handle = static_cast<pipeline_handle_t>(slots.size());
+  slots.push_back({std::move(recipe), handle});
+
+  for (const auto &name : slots[handle].recipe.shaders)
+    watched.try_emplace(name);
+
+  auto &slot = slots[handle];
+  slot.requested = 1;
+
+  const auto result = compile(make_job(handle));
+  ASSERT(result.pipeline != VK_NULL_HANDLE);
+
+  slot.pipeline = result.pipeline;
+  slot.applied = result.generation;
+  return handle;
+}
+
+pipeline_handle_t
+pipeline_manager_t::create_async(pipeline_recipe_t recipe,
+                                 const pipeline_handle_t fallback) {
+  ASSERT(fallback < slots.size());
+
+  const auto handle = static_cast<pipeline_handle_t>(slots.size());
+  slots.push_back({std::move(recipe), fallback});
+
+  for (const auto &name : slots[handle].recipe.shaders)
+    watched.try_emplace(name);
+
+  slots[handle].requested = 1;
+  queue(make_job(handle));
+
+  return handle;
+}
+
+void pipeline_manager_t::begin_frame(const uint64_t frame,
+                                     const uint64_t completed) {
+  // frames before the one a pipeline was replaced at are the last to use it
+  std::erase_if(retired, [&](const auto &entry) {
+    if (completed < entry.second)
+      return false;
+
+    vkDestroyPipeline(device, entry.first, nullptr);
+    return true;
+  });
+
+  std::vector<result_t> finished = {};
+  {
+    const std::scoped_lock lock{mutex};
+    finished.swap(results);
+  }
+
+  for (const auto &result : finished) {
+    in_flight -= 1;
+
+    // a failed reload keeps drawing with what it had, a stale one was
+    // overtaken by a later compile that finished first
+    auto &slot = slots[result.handle];
+    if (result.pipeline == VK_NULL_HANDLE)
+      continue;
+
+    if (result.generation <= slot.applied) {
+      vkDestroyPipeline(device, result.pipeline, nullptr);
+      continue;
+    }
+
+    if (slot.pipeline != VK_NULL_HANDLE)
+      retired.emplace_back(slot.pipeline, frame);
+
+    slot.pipeline = result.pipeline;
+    slot.applied = result.generation;
+  }
+
+  if (!shader_dir.empty() &&
+      std::chrono::steady_clock::now() - last_poll >= poll_interval) {
+    last_poll = std::chrono::steady_clock::now();
+    poll_shaders();
+  }
+}
+
+VkPipeline pipeline_manager_t::get(const pipeline_handle_t handle) const {
+  // fallbacks are created before the handles falling back to them, the
+  // chain ends at one created ready
+  auto index = handle;
+  while (slots[index].pipeline == VK_NULL_HANDLE)
+    index = slots[index].fallback;
+
+  return slots[index].pipeline;
+}
+
+pipeline_manager_t::job_t
+pipeline_manager_t::make_job(const pipeline_handle_t handle) {
+  const auto &slot = slots[handle];
+
+  job_t job = {};
+  job.handle = handle;
+  job.generation = slot.requested;
+  job.shaders = slot.recipe.shaders;
+  job.build = slot.recipe.build;
+  for (const auto &name : slot.recipe.shaders)
+    job.from_disk.push_back(watched[name].reloaded);
+
+  return job;
+}
+
+pipeline_manager_t::result_t
+pipeline_manager_t::compile(const job_t &job) const {
+  result_t result = {job.handle, job.generation, VK_NULL_HANDLE};
+
+  std::vector<VkShaderModule> modules = {};
+  std::vector<VkPipelineShaderStageCreateInfo> stages = {};
+  const auto destroy_modules = [&] {
+    for (const auto module : modules)
+      vkDestroyShaderModule(device, module, nullptr);
+  };
+
+  for (size_t index = 0; index < job.shaders.size(); index += 1) {
+    const auto &name = job.shaders[index];
+
+    std::vector<uint32_t> words = {};
+    std::span<const uint32_t> code = find_shader(name).code;
+    if (job.from_disk[index]) {
+      words = read_spirv_words(shader_dir / (name + ".spv.inc"));
+      code = words;
+    }
+
+    if (code.empty()) {
+      std::cout << "pipelines: " << name << ": no spir-v" << std::endl;
+      destroy_modules();
+      return result;
+    }
+
+    VkShaderModuleCreateInfo module_info = {};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = code.size_bytes();
+    module_info.pCode = code.data();
+
+    VkShaderModule module = {};
+    if (vkCreateShaderModule(device, &module_info, nullptr, &module) !=
+        VK_SUCCESS) {
+      std::cout << "pipelines: " << name << ": bad spir-v" << std::endl;
+      destroy_modules();
+      return result;
+    }
+    modules.push_back(module);
+
+    VkPipelineShaderStageCreateInfo stage = {};
+    stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage.stage = shader_stage(name);
+    stage.module = module;
+    stage.pName = "main";
+    stages.push_back(stage);
+  }
+
+  if (job.build(stages, result.pipeline) != VK_SUCCESS) {
+    std::cout << "pipelines: " << job.handle << ": failed to compile"
+              << std::endl;
+    result.pipeline = VK_NULL_HANDLE;
+  }
+
+  destroy_modules();
+  return result;
+}
+
+void pipeline_manager_t::poll_shaders() {
+  std::vector<std::string> rebuilt = {};
+  for (auto &[name, entry] : watched) {
+    std::error_code error = {};
+    const auto time =
+        std::filesystem::last_write_time(shader_dir / (name + ".spv.inc"),
+                                         error);
+    if (error)
+      continue;
+
+    // first sight of the file, it is what the embedded code was built from
+    if (entry.time == std::filesystem::file_time_type{}) {
+      entry.time = entry.pending = time;
+      continue;
+    }
+
+    // wait for the build to stop writing, one poll without a change
+    const auto settled = time == entry.pending;
+    entry.pending = time;
+    if (time == entry.time || !settled)
+      continue;
+
+    entry.time = time;
+    entry.reloaded = true;
+    rebuilt.push_back(name);
+  }
+
+  if (rebuilt.empty())
+    return;
+
+  std::vector<job_t> queued = {};
+  for (pipeline_handle_t handle = 0; handle < slots.size(); handle += 1) {
+    const auto &shaders = slots[handle].recipe.shaders;
+    const auto uses = std::any_of(
+        shaders.begin(), shaders.end(), [&](const auto &name) {
+          return std::find(rebuilt.begin(), rebuilt.end(), name) !=
+                 rebuilt.end();
+        });
+
+    if (!uses)
+      continue;
+
+    slots[handle].requested += 1;
+    queued.push_back(make_job(handle));
+  }
+
+  for (const auto &name : rebuilt)
+    std::cout << "pipelines: reloading " << name << ", " << queued.size()
+              << " pipelines" << std::endl;
+
+  for (auto &job : queued)
+    queue(std::move(job));
+}
+
+void pipeline_manager_t::queue(job_t job) {
+  in_flight += 1;
+  {
+    const std::scoped_lock lock{mutex};
+    outstanding += 1;
+  }
+
+  jobs.submit_background([this, job = std::move(job)] {
+    {
+      const std::scoped_lock lock{mutex};
+      if (stopping) {
+        outstanding -= 1;
+        idle.notify_all();
+        return;
+      }
+    }
+
+    const auto result = compile(job);
+
+    const std::scoped_lock lock{mutex};
+    results.push_back(result);
+    outstanding -= 1;
+    idle.notify_all();
+  });
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "job_system.hpp"
+
+using pipeline_handle_t = uint32_t;
+
+// what a pipeline is built from, build is handed one stage per shader in
+// order and may run on any thread
+struct pipeline_recipe_t {
+  using build_fn_t = std::function<VkResult(
+      std::span<const VkPipelineShaderStageCreateInfo>, VkPipeline &)>;
+
+  std::vector<std::string> shaders = {}; // embedded names, eg: default.vert
+  build_fn_t build = {};
+};
+
+// builds pipelines as background jobs and swaps them in between frames
+//
+// a handle's pipeline never changes while a frame is recorded, begin_frame()
+// is the only place compiled pipelines are swapped in, and a replaced one is
+// destroyed once every frame that may have drawn with it has completed
+//
+// handles created asynchronously draw with their fallback until compiled
+//
+// with a shader directory, the .spv.inc outputs of the glslangValidator step
+// are polled and every pipeline using a rebuilt shader is compiled again,
+// a shader that fails to load or compile keeps the previous pipeline
+//
+// everything but compiling runs on one thread at a time, the render thread
+// once frames start, get() may also be called from recording jobs
+class pipeline_manager_t {
+public:
+  static constexpr auto poll_interval = std::chrono::milliseconds{250};
+
+  pipeline_manager_t(VkDevice, job_system_t &,
+                     const std::filesystem::path &shader_dir = {});
+
+  // the device must be idle, queued compiles are dropped and running ones
+  // waited for
+  ~pipeline_manager_t();
+
+  pipeline_manager_t(const pipeline_manager_t &) = delete;
+  pipeline_manager_t &operator=(const pipeline_manager_t &) = delete;
+
+  // compiled before returning, for pipelines other handles fall back to
+  pipeline_handle_t create(pipeline_recipe_t);
+
+  // compiled on a worker, drawn with fallback's pipeline until then
+  pipeline_handle_t create_async(pipeline_recipe_t,
+                                 const pipeline_handle_t fallback);
+
+  // once per frame before recording, completed is the number of frames the
+  // gpu has finished, ie: the frame scheduler's completed value
+  void begin_frame(const uint64_t frame, const uint64_t completed);
+
+  VkPipeline get(const pipeline_handle_t) const;
+  bool ready(const pipeline_handle_t handle) const {
+    return slots[handle].pipeline != VK_NULL_HANDLE;
+  }
+
+  uint32_t compiling() const { return in_flight; }
+
+private:
+  struct slot_t {
+    pipeline_recipe_t recipe = {};
+    pipeline_handle_t fallback = 0;
+    VkPipeline pipeline = {}; // null until first compiled
+    uint64_t requested = 0;   // generation of the last queued compile
+    uint64_t applied = 0;     // generation of pipeline
+  };
+
+  struct job_t {
+    pipeline_handle_t handle = 0;
+    uint64_t generation = 0;
+    std::vector<std::string> shaders = {};
+    std::vector<bool> from_disk = {}; // per shader, else the embedded code
+    pipeline_recipe_t::build_fn_t build = {};
+  };
+
+  struct result_t {
+    pipeline_handle_t handle = 0;
+    uint64_t generation = 0;
+    VkPipeline pipeline = {}; // null when compiling failed
+  };
+
+  // rebuilt shaders are only picked up once their file stops changing
+  struct watched_t {
+    std::filesystem::file_time_type time = {};    // last compiled from
+    std::filesystem::file_time_type pending = {}; // seen at the last poll
+    bool reloaded = false;                        // compiled from disk since
+  };
+
+  job_t make_job(const pipeline_handle_t);
+  result_t compile(const job_t &) const;
+  void poll_shaders();
+  void queue(job_t);
+
+  VkDevice device;
+  job_system_t &jobs;
+  const std::filesystem::path shader_dir;
+
+  std::vector<slot_t> slots = {};
+  std::unordered_map<std::string, watched_t> watched = {};
+  std::chrono::steady_clock::time_point last_poll = {};
+  uint32_t in_flight = 0;
+
+  // replaced pipelines and the frame they were replaced before
+  std::vector<std::pair<VkPipeline, uint64_t>> retired = {};
+
+  std::mutex mutex;
+  std::condition_variable idle;
+  std::vector<result_t> results = {};
+  uint32_t outstanding = 0; // jobs submitted and not yet run
+  bool stopping = false;
+};
@@ -0,0 +1,197 @@
+#include "globals.hpp"
+
+#include "instances.hpp"
+#include "pipeline_state.hpp"
+
+namespace {
+
+struct vertex_input_t {
+  std::span<const VkVertexInputBindingDescription> bindings = {};
+  std::span<const VkVertexInputAttributeDescription> attributes = {};
+};
+
+constexpr VkVertexInputBindingDescription instanced_2d_bindings[] = {
+    {0, sizeof(float) * 2, VK_VERTEX_INPUT_RATE_VERTEX},
+    instance_binding_description,
+};
+
+constexpr VkVertexInputAttributeDescription instanced_2d_attributes[] = {
+    {0, 0, VK_FORMAT_R32G32_SFLOAT, 0},
+    instance_attributes[0],
+    instance_attributes[1],
+    instance_attributes[2],
+    instance_attributes[3],
+};
+
+// by vertex_format_t
+constexpr vertex_input_t vertex_inputs[] = {
+    {instanced_2d_bindings, instanced_2d_attributes},
+};
+
+constexpr VkColorComponentFlags all_components =
+    VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+// by blend_mode_t
+constexpr VkPipelineColorBlendAttachmentState blend_states[] = {
+    {VK_FALSE, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO, VK_BLEND_OP_ADD,
+     VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ZERO, VK_BLEND_OP_ADD,
+     all_components},
+    {VK_TRUE, VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+     VK_BLEND_OP_ADD, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+     VK_BLEND_OP_ADD, all_components},
+    {VK_TRUE, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE, VK_BLEND_OP_ADD,
+     VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE, VK_BLEND_OP_ADD,
+     all_components},
+};
+
+// constant_id n reads constants[n]
+constexpr auto specialization_entries = [] {
+  std::array<VkSpecializationMapEntry, pipeline_key_t::max_constants>
+      entries = {};
+  for (uint32_t id = 0; id < entries.size(); id += 1)
+    entries[id] = {id, static_cast<uint32_t>(id * sizeof(uint32_t)),
+                   sizeof(uint32_t)};
+  return entries;
+}();
+
+} // namespace
+
+size_t pipeline_key_hash_t::operator()(const pipeline_key_t &key) const {
+  // boost style combine, the fields are small so collisions stay rare
+  size_t hash = 0;
+  const auto combine = [&](const size_t value) {
+    hash ^= value + 0x9e37'79b9 + (hash << 6) + (hash >> 2);
+  };
+
+  combine(static_cast<size_t>(key.vertex_format));
+  combine(static_cast<size_t>(key.topology));
+  combine(static_cast<size_t>(key.cull_mode));
+  combine(static_cast<size_t>(key.front_face));
+  combine(static_cast<size_t>(key.blend));
+  for (const auto constant : key.constants)
+    combine(constant);
+
+  return hash;
+}
+
+VkResult create_graphics_pipeline(
+    VkDevice device, VkPipelineCache cache, VkPipelineLayout layout,
+    VkRenderPass render_pass, const pipeline_key_t &key,
+    std::span<const VkPipelineShaderStageCreateInfo> stages,
+    VkPipeline &pipeline) {
+  // every stage sees every constant, the ones it does not declare are ignored
+  VkSpecializationInfo specialization = {};
+  specialization.mapEntryCount = specialization_entries.size();
+  specialization.pMapEntries = specialization_entries.data();
+  specialization.dataSize = sizeof(key.constants);
+  specialization.pData = key.constants.data();
+
+  std::vector<VkPipelineShaderStageCreateInfo> specialized{stages.begin(),
+                                                           stages.end()};
+  for (auto &stage : specialized)
+    stage.pSpecializationInfo = &specialization;
+
+  const auto &input = vertex_inputs[static_cast<size_t>(key.vertex_format)];
+
+  VkPipelineVertexInputStateCreateInfo vertex_input = {};
+  vertex_input.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(input.bindings.size());
+  vertex_input.pVertexBindingDescriptions = input.bindings.data();
+  vertex_input.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(input.attributes.size());
+  vertex_input.pVertexAttributeDescriptions = input.attributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+  input_assembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly.topology = key.topology;
+  input_assembly.primitiveRestartEnable = VK_FALSE;
+
+  // set while recording, tiles scissor away what hangs over the image
+  const std::array<VkDynamicState, 2> dynamic_states = {
+      VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+  VkPipelineDynamicStateCreateInfo dynamic_state = {};
+  dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic_state.dynamicStateCount = dynamic_states.size();
+  dynamic_state.pDynamicStates = dynamic_states.data();
+
+  VkPipelineViewportStateCreateInfo viewport_state = {};
+  viewport_state.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport_state.viewportCount = 1;
+  viewport_state.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {};
+  rasterizer.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.cullMode = key.cull_mode;
+  rasterizer.frontFace = key.front_face;
+  rasterizer.depthBiasEnable = VK_FALSE;
+  rasterizer.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {};
+  multisampling.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineColorBlendStateCreateInfo blending = {};
+  blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  blending.logicOpEnable = VK_FALSE;
+  blending.attachmentCount = 1;
+  blending.pAttachments = &blend_states[static_cast<size_t>(key.blend)];
+
+  VkGraphicsPipelineCreateInfo pipeline_info = {};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipeline_info.stageCount = static_cast<uint32_t>(specialized.size());
+  pipeline_info.pStages = specialized.data();
+  pipeline_info.pVertexInputState = &vertex_input;
+  pipeline_info.pInputAssemblyState = &input_assembly;
+  pipeline_info.pViewportState = &viewport_state;
+  pipeline_info.pDynamicState = &dynamic_state;
+  pipeline_info.pRasterizationState = &rasterizer;
+  pipeline_info.pMultisampleState = &multisampling;
+  pipeline_info.pColorBlendState = &blending;
+  pipeline_info.layout = layout;
+  pipeline_info.renderPass = render_pass;
+
+  return vkCreateGraphicsPipelines(device, cache, 1, &pipeline_info, nullptr,
+                                   &pipeline);
+}
+
+pipeline_variants_t::pipeline_variants_t(
+    pipeline_manager_t &manager, VkDevice device, VkPipelineCache cache,
+    VkPipelineLayout layout, VkRenderPass render_pass,
+    std::span<const std::string_view> shaders)
+    : manager{manager}, device{device}, cache{cache}, layout{layout},
+      render_pass{render_pass}, shaders{shaders.begin(), shaders.end()} {}
+
+pipeline_handle_t pipeline_variants_t::get(const pipeline_key_t &key) {
+  if (const auto found = handles.find(key); found != handles.end())
+    return found->second;
+
+  pipeline_recipe_t recipe = {};
+  recipe.shaders = shaders;
+  // runs on the manager's threads, captures nothing it does not own
+  recipe.build = [device = device, cache = cache, layout = layout,
+                  render_pass = render_pass,
+                  key](const auto stages, VkPipeline &pipeline) {
+    return create_graphics_pipeline(device, cache, layout, render_pass, key,
+                                    stages, pipeline);
+  };
+
+  const auto handle = handles.empty()
+                          ? manager.create(std::move(recipe))
+                          : manager.create_async(std::move(recipe), fallback);
+  if (handles.empty())
+    fallback = handle;
+
+  handles.emplace(key, handle);
+  return handle;
+}
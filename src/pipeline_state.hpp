@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "pipeline_manager.hpp"
+
+// vertex buffer layouts the scene can be drawn from
+enum class vertex_format_t : uint8_t {
+  instanced_2d, // xy positions, instance_t per instance
+};
+
+enum class blend_mode_t : uint8_t {
+  opaque,
+  alpha,    // straight alpha over what is there
+  additive, // src + dst
+};
+
+// values of the specialization constants of default.frag, by constant_id
+enum class scene_constant_t : uint32_t {
+  textured, // 0 skips sampling textures altogether
+  shading,  // scene_shading_t
+  count,
+};
+
+enum class scene_shading_t : uint32_t {
+  lit, // vertex color times the material's tint and texture
+  uv,  // texture coordinates, for checking the mapping
+};
+
+// everything that varies between the scene's pipelines, pipelines with equal
+// keys are interchangeable
+struct pipeline_key_t {
+  static constexpr size_t max_constants =
+      static_cast<size_t>(scene_constant_t::count);
+
+  vertex_format_t vertex_format = vertex_format_t::instanced_2d;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
+  blend_mode_t blend = blend_mode_t::opaque;
+  std::array<uint32_t, max_constants> constants = {1, 0}; // by constant_id
+
+  constexpr pipeline_key_t with(const scene_constant_t constant,
+                                const uint32_t value) const {
+    auto key = *this;
+    key.constants[static_cast<size_t>(constant)] = value;
+    return key;
+  }
+
+  bool operator==(const pipeline_key_t &) const = default;
+};
+
+struct pipeline_key_hash_t {
+  size_t operator()(const pipeline_key_t &) const;
+};
+
+struct pipeline_variant_t {
+  std::string_view name = {};
+  pipeline_key_t key = {};
+};
+
+// the scene's known variants, the first is the default every other variant
+// falls back to while it compiles
+constexpr std::array scene_variants = {
+    pipeline_variant_t{"default", {}},
+    pipeline_variant_t{
+        "untextured", pipeline_key_t{}.with(scene_constant_t::textured, 0)},
+    pipeline_variant_t{
+        "uv", pipeline_key_t{}.with(scene_constant_t::shading,
+                                    static_cast<uint32_t>(
+                                        scene_shading_t::uv))},
+    pipeline_variant_t{"additive",
+                       {.blend = blend_mode_t::additive}},
+    pipeline_variant_t{"unculled",
+                       {.cull_mode = VK_CULL_MODE_NONE}},
+};
+
+// null when no variant has that name
+template <size_t count>
+constexpr const pipeline_variant_t *
+find_variant(const std::array<pipeline_variant_t, count> &variants,
+             const std::string_view name) {
+  for (const auto &variant : variants)
+    if (variant.name == name)
+      return &variant;
+
+  return nullptr;
+}
+
+static_assert(find_variant(scene_variants, "default") == &scene_variants[0]);
+
+// graphics pipeline for the key, stages are specialized with its constants
+VkResult create_graphics_pipeline(
+    VkDevice, VkPipelineCache, VkPipelineLayout, VkRenderPass,
+    const pipeline_key_t &, std::span<const VkPipelineShaderStageCreateInfo>,
+    VkPipeline &);
+
+// one pipeline per distinct key, all built from the same shaders, layout and
+// render pass through the pipeline manager
+//
+// the first key requested is compiled before returning and every later one
+// draws with it until its own pipeline is ready
+class pipeline_variants_t {
+public:
+  pipeline_variants_t(pipeline_manager_t &, VkDevice, VkPipelineCache,
+                      VkPipelineLayout, VkRenderPass,
+                      std::span<const std::string_view> shaders);
+
+  pipeline_handle_t get(const pipeline_key_t &);
+
+  size_t size() const { return handles.size(); }
+
+private:
+  pipeline_manager_t &manager;
+  VkDevice device;
+  VkPipelineCache cache;
+  VkPipelineLayout layout;
+  VkRenderPass render_pass;
+  std::vector<std::string> shaders;
+
+  std::unordered_map<pipeline_key_t, pipeline_handle_t, pipeline_key_hash_t>
+      handles = {};
+  pipeline_handle_t fallback = 0;
+};
@@ -0,0 +1,60 @@
+#include <vector>
+
+#include "globals.hpp"
+
+#include "queues.hpp"
+
+queue_families_t find_queue_families(VkPhysicalDevice physical_device,
+                                     VkSurfaceKHR surface, const bool async) {
+  uint32_t family_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count,
+                                           nullptr);
+
+  std::vector<VkQueueFamilyProperties> families{family_count};
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count,
+                                           families.data());
+
+  queue_families_t result = {};
+  for (uint32_t index = 0; index < family_count; index += 1) {
+    if (!(families[index].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+      continue;
+
+    VkBool32 present_support = surface == VK_NULL_HANDLE;
+    if (surface != VK_NULL_HANDLE)
+      VK_CALL(vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, index,
+                                                   surface, &present_support));
+
+    if (present_support) {
+      result.graphics = index;
+      result.timestamp_valid_bits = families[index].timestampValidBits;
+      break;
+    }
+  }
+
+  ASSERT(result.graphics != UINT32_MAX);
+  result.compute = result.graphics;
+  result.transfer = result.graphics;
+
+  if (!async)
+    return result;
+
+  // first family of each kind, transfer only families are usually the copy
+  // engines that run next to the graphics queue
+  for (uint32_t index = 0; index < family_count; index += 1) {
+    const auto flags = families[index].queueFlags;
+    const auto graphics = (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+    const auto compute = (flags & VK_QUEUE_COMPUTE_BIT) != 0;
+    const auto transfer = (flags & VK_QUEUE_TRANSFER_BIT) != 0;
+
+    if (compute && !graphics && !result.dedicated_compute())
+      result.compute = index;
+
+    if (transfer && !compute && !graphics && !result.dedicated_transfer()) {
+      result.transfer = index;
+      result.transfer_granularity =
+          families[index].minImageTransferGranularity;
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+// queue families picked for each kind of work, kinds without a dedicated
+// family fall back to the graphics family and share its queue
+//
+// culling is recorded into the frame on the graphics queue since the draws
+// right after it consume its results, readback conversion runs on the compute
+// family and overlaps the next frame's rendering
+struct queue_families_t {
+  uint32_t graphics = UINT32_MAX;    // graphics, and present when windowed
+  uint32_t compute = UINT32_MAX;     // async compute, no graphics
+  uint32_t transfer = UINT32_MAX;    // transfer only, eg: dma engines
+  uint32_t timestamp_valid_bits = 0; // of the graphics family
+
+  // minImageTransferGranularity of the transfer family, (0,0,0) allows only
+  // whole mip level copies
+  VkExtent3D transfer_granularity = {1, 1, 1};
+
+  bool dedicated_compute() const { return compute != graphics; }
+  bool dedicated_transfer() const { return transfer != graphics; }
+};
+
+// surface may be null when rendering offscreen, async disables the dedicated
+// compute and transfer families
+queue_families_t find_queue_families(VkPhysicalDevice, VkSurfaceKHR,
+                                     const bool async);
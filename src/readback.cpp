@@ -0,0 +1,166 @@
+#include <algorithm>
+
+#include "globals.hpp"
+
+#include "readback.hpp"
+
+bool parse_readback_layout(const std::string_view name,
+                           readback_layout_t &layout) {
+  if (name == "rgba8")
+    layout = readback_layout_t::rgba8;
+  else if (name == "rgb8")
+    layout = readback_layout_t::rgb8;
+  else if (name == "yuv420")
+    layout = readback_layout_t::yuv420;
+  else
+    return false;
+
+  return true;
+}
+
+namespace {
+VkDeviceSize payload_size(const readback_layout_t layout,
+                          const VkExtent2D extent) {
+  const VkDeviceSize texels = VkDeviceSize{extent.width} * extent.height;
+  const VkDeviceSize chroma = VkDeviceSize{(extent.width + 1) / 2} *
+                              ((extent.height + 1) / 2);
+
+  switch (layout) {
+  case readback_layout_t::rgba8:
+    return texels * 4;
+  case readback_layout_t::rgb8:
+    return texels * 3;
+  case readback_layout_t::yuv420:
+    return texels + 2 * chroma;
+  }
+
+  return 0;
+}
+} // namespace
+
+VkDeviceSize readback_size(const readback_layout_t layout,
+                           const VkExtent2D extent) {
+  // the conversion pass writes whole words
+  return (payload_size(layout, extent) + 3) & ~VkDeviceSize{3};
+}
+
+VkRect2D readback_region(const VkExtent2D target, const VkRect2D crop) {
+  if (crop.extent.width == 0 || crop.extent.height == 0)
+    return {{0, 0}, target};
+
+  const auto x = std::clamp<int32_t>(crop.offset.x, 0, target.width);
+  const auto y = std::clamp<int32_t>(crop.offset.y, 0, target.height);
+  return {{x, y},
+          {std::min(crop.extent.width, target.width - x),
+           std::min(crop.extent.height, target.height - y)}};
+}
+
+VkExtent2D readback_extent(const VkRect2D region, const uint32_t scale) {
+  ASSERT(scale > 0);
+  return {region.extent.width / scale, region.extent.height / scale};
+}
+
+void record_readback(VkCommandBuffer cmd_buffer, VkImage image,
+                     const VkExtent2D extent, const readback_slot_t &slot,
+                     const VkImageLayout final_layout) {
+  record_image_copy(cmd_buffer, image, extent, slot.buffer, final_layout,
+                    VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+void record_image_copy(VkCommandBuffer cmd_buffer, VkImage image,
+                       const VkExtent2D extent, VkBuffer buffer,
+                       const VkImageLayout final_layout,
+                       const VkPipelineStageFlags dst_stage,
+                       const VkAccessFlags dst_access,
+                       const uint32_t src_family,
+                       const uint32_t dst_family) {
+  VkImageSubresourceRange range = {};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = 1;
+  range.layerCount = 1;
+
+  // wait for the render pass to finish writing the image
+  {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+
+    vkCmdPipelineBarrier(cmd_buffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+  }
+
+  VkBufferImageCopy region = {};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {extent.width, extent.height, 1};
+
+  vkCmdCopyImageToBuffer(cmd_buffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1,
+                         &region);
+
+  // make the copy visible to its reader, and hand the image back to present
+  {
+    const auto release = src_family != dst_family;
+
+    VkBufferMemoryBarrier buffer_barrier = {};
+    buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buffer_barrier.dstAccessMask = release ? 0 : dst_access;
+    buffer_barrier.srcQueueFamilyIndex = src_family;
+    buffer_barrier.dstQueueFamilyIndex = dst_family;
+    buffer_barrier.buffer = buffer;
+    buffer_barrier.size = VK_WHOLE_SIZE;
+
+    VkImageMemoryBarrier image_barrier = {};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    image_barrier.dstAccessMask = 0;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.newLayout = final_layout;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image = image;
+    image_barrier.subresourceRange = range;
+
+    const auto transition = final_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         (release ? 0 : dst_stage) |
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0, 0, nullptr, 1, &buffer_barrier, transition ? 1 : 0,
+                         &image_barrier);
+  }
+}
+
+void deliver_readback(VkDevice device, readback_slot_t &slot,
+                      const VkExtent2D extent, const VkFormat format,
+                      const readback_layout_t layout,
+                      const readback_callback_t &callback) {
+  if (!slot.pending)
+    return;
+
+  invalidate_allocation(device, slot.allocation);
+
+  const readback_frame_t frame = {
+      .frame = slot.frame,
+      .extent = extent,
+      .format = format,
+      .data = {slot.allocation.mapped,
+               static_cast<size_t>(payload_size(layout, extent))},
+      .layout = layout,
+  };
+
+  callback(frame);
+  slot.pending = false;
+}
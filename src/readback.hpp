@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.hpp"
+
+// texel layout of frames in host memory, everything but a full size rgba8
+// readback is converted on the gpu before the copy to host memory
+enum class readback_layout_t {
+  rgba8,  // 4 bytes per texel, in the render target format's channel order
+  rgb8,   // 3 bytes per texel, red first
+  yuv420, // full range bt.601 planes, y then u then v at half resolution
+};
+
+constexpr std::string_view readback_layout_names[] = {"rgba8", "rgb8",
+                                                      "yuv420"};
+
+bool parse_readback_layout(const std::string_view, readback_layout_t &);
+
+// bytes of a frame, rounded up to whole words
+VkDeviceSize readback_size(const readback_layout_t, const VkExtent2D);
+
+// crop clamped to the target, the whole target when the crop is empty
+VkRect2D readback_region(const VkExtent2D target, const VkRect2D crop);
+
+// extent of a region downscaled by an integer factor
+VkExtent2D readback_extent(const VkRect2D region, const uint32_t scale);
+
+// a rendered frame in host memory, data aliases the mapped staging buffer and
+// is only valid for the duration of the callback
+struct readback_frame_t {
+  uint64_t frame = 0;                    // frame number
+  VkExtent2D extent = {};                // extent after crop and scale
+  VkFormat format = VK_FORMAT_UNDEFINED; // render target texel format
+  std::span<const std::byte> data = {};  // tightly packed rows or planes
+  readback_layout_t layout = readback_layout_t::rgba8;
+};
+
+using readback_callback_t = std::function<void(const readback_frame_t &)>;
+
+// persistently mapped staging buffer, one per frame in flight
+struct readback_slot_t {
+  VkBuffer buffer = {};
+  gpu_allocation_t allocation = {}; // persistently mapped readback memory
+  VkDeviceSize size = 0;            // bytes per frame
+
+  uint64_t frame = 0;   // frame last copied into this slot
+  bool pending = false; // copied on gpu, not yet handed to the caller
+};
+
+// copy a rendered image in TRANSFER_SRC_OPTIMAL layout into a buffer and make
+// it visible to dst_stage, transitions the image to final_layout afterwards
+//
+// with queue family indices the buffer is released from src_family to
+// dst_family instead, dst_stage and dst_access are ignored
+void record_image_copy(VkCommandBuffer, VkImage, const VkExtent2D, VkBuffer,
+                       const VkImageLayout final_layout,
+                       const VkPipelineStageFlags dst_stage,
+                       const VkAccessFlags dst_access,
+                       const uint32_t src_family = VK_QUEUE_FAMILY_IGNORED,
+                       const uint32_t dst_family = VK_QUEUE_FAMILY_IGNORED);
+
+// copy a rendered image as is into the slot buffer for the host
+void record_readback(VkCommandBuffer, VkImage, const VkExtent2D,
+                     const readback_slot_t &, const VkImageLayout final_layout);
+
+// hand a completed slot to the caller, the frame it was copied in must have
+// completed, size is the frame's payload without padding
+void deliver_readback(VkDevice, readback_slot_t &, const VkExtent2D,
+                      const VkFormat, const readback_layout_t,
+                      const readback_callback_t &);
@@ -0,0 +1,274 @@
+#include <array>
+
+#include "globals.hpp"
+
+#include "readback_convert.hpp"
+#include "shader_registry.hpp"
+
+namespace {
+
+// matches constants_t in readback_convert.comp
+struct convert_constants_t {
+  int32_t origin[2] = {};
+  uint32_t source_width = 0;
+  uint32_t scale = 1;
+  uint32_t extent[2] = {};
+  uint32_t layout = 0;
+  uint32_t swap_rb = 0;
+  uint32_t word_count = 0;
+};
+
+constexpr uint32_t workgroup_size = 64;
+
+bool blue_first(const VkFormat format) {
+  return format == VK_FORMAT_B8G8R8A8_SRGB ||
+         format == VK_FORMAT_B8G8R8A8_UNORM;
+}
+
+} // namespace
+
+readback_converter_t::readback_converter_t(
+    VkDevice device, gpu_allocator_t &allocator,
+    VkPipelineCache pipeline_cache, const VkPhysicalDeviceLimits &limits,
+    const uint32_t queue_family_index, const uint32_t compute_family_index,
+    const VkExtent2D target,
+    const VkFormat format, const VkRect2D region, const uint32_t scale,
+    const readback_layout_t layout,
+    const std::span<const readback_slot_t> slots)
+    : device{device}, allocator{allocator}, src_family{queue_family_index},
+      compute_family{compute_family_index}, target{target}, region{region},
+      scale{scale}, layout{layout}, swap_rb{blue_first(format)},
+      output_extent{readback_extent(region, scale)},
+      output_size{readback_size(layout, output_extent)} {
+  ASSERT(!slots.empty());
+  ASSERT(output_extent.width > 0 && output_extent.height > 0);
+
+  // a 4k rgb8 frame alone is more words than most devices allow groups
+  // along x
+  const auto word_count = static_cast<uint32_t>(output_size / 4);
+  groups = dispatch_groups(
+      (word_count + workgroup_size - 1) / workgroup_size, limits);
+
+  // a conversion may still read one slot's copy while the next frame copies
+  // into another
+  {
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = VkDeviceSize{target.width} * target.height * 4;
+    buffer_info.usage =
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    raw.resize(slots.size());
+    raw_memory.resize(slots.size());
+    for (size_t index = 0; index < slots.size(); index += 1)
+      raw_memory[index] = allocator.create_buffer(
+          buffer_info, memory_usage_t::gpu_only, raw[index]);
+  }
+
+  for (const auto &slot : slots) {
+    ASSERT(slot.size >= output_size);
+    outputs.push_back(slot.buffer);
+  }
+
+  // frame n's copy signals n + 1, the conversion waits on it
+  if (async()) {
+    VkSemaphoreTypeCreateInfo type_info = {};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    create_info.pNext = &type_info;
+    VK_CALL(vkCreateSemaphore(device, &create_info, nullptr, &semaphore));
+
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = compute_family;
+    VK_CALL(vkCreateCommandPool(device, &pool_info, nullptr, &cmd_pool));
+
+    cmd_buffers.resize(slots.size());
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandPool = cmd_pool;
+    alloc_info.commandBufferCount = static_cast<uint32_t>(cmd_buffers.size());
+    VK_CALL(vkAllocateCommandBuffers(device, &alloc_info, cmd_buffers.data()));
+  }
+
+  // raw copy, slot buffer
+  {
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+    for (uint32_t index = 0; index < bindings.size(); index += 1) {
+      bindings[index].binding = index;
+      bindings[index].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      bindings[index].descriptorCount = 1;
+      bindings[index].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = bindings.size();
+    layout_info.pBindings = bindings.data();
+    VK_CALL(vkCreateDescriptorSetLayout(device, &layout_info, nullptr,
+                                        &set_layout));
+
+    VkPushConstantRange push_range = {};
+    push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_range.size = sizeof(convert_constants_t);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+    pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_range;
+    VK_CALL(vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr,
+                                   &pipeline_layout));
+  }
+
+  {
+    const auto set_count = static_cast<uint32_t>(outputs.size());
+
+    VkDescriptorPoolSize pool_size = {};
+    pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount = 2 * set_count;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = set_count;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    VK_CALL(vkCreateDescriptorPool(device, &pool_info, nullptr,
+                                   &descriptor_pool));
+
+    const std::vector<VkDescriptorSetLayout> layouts(set_count, set_layout);
+    descriptor_sets.resize(set_count);
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool;
+    alloc_info.descriptorSetCount = set_count;
+    alloc_info.pSetLayouts = layouts.data();
+    VK_CALL(vkAllocateDescriptorSets(device, &alloc_info,
+                                     descriptor_sets.data()));
+
+    for (uint32_t slot = 0; slot < set_count; slot += 1) {
+      const std::array<VkDescriptorBufferInfo, 2> buffer_infos = {{
+          {raw[slot], 0, VK_WHOLE_SIZE},
+          {outputs[slot], 0, output_size},
+      }};
+
+      std::array<VkWriteDescriptorSet, 2> writes = {};
+      for (uint32_t index = 0; index < writes.size(); index += 1) {
+        writes[index].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[index].dstSet = descriptor_sets[slot];
+        writes[index].dstBinding = index;
+        writes[index].descriptorCount = 1;
+        writes[index].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[index].pBufferInfo = &buffer_infos[index];
+      }
+
+      vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+    }
+  }
+
+  pipeline = create_compute_pipeline(device, pipeline_cache, pipeline_layout,
+                                     "readback_convert.comp");
+}
+
+readback_converter_t::~readback_converter_t() {
+  vkDestroyPipeline(device, pipeline, nullptr);
+  vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+  vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+  vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+  vkDestroyCommandPool(device, cmd_pool, nullptr);
+  vkDestroySemaphore(device, semaphore, nullptr);
+
+  for (size_t index = 0; index < raw.size(); index += 1)
+    allocator.destroy_buffer(raw[index], raw_memory[index]);
+}
+
+void readback_converter_t::record(VkCommandBuffer cmd_buffer, VkImage image,
+                                  const uint32_t slot,
+                                  const VkImageLayout final_layout) const {
+  // clang-format off
+  if (async()) {
+    record_image_copy(cmd_buffer, image, target, raw[slot], final_layout, 0, 0, src_family, compute_family);
+    return;
+  }
+
+  record_image_copy(cmd_buffer, image, target, raw[slot], final_layout, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+  // clang-format on
+
+  record_dispatch(cmd_buffer, slot);
+}
+
+VkCommandBuffer readback_converter_t::record_async(const uint32_t slot) const {
+  ASSERT(async());
+  const auto cmd_buffer = cmd_buffers[slot];
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  VK_CALL(vkResetCommandBuffer(cmd_buffer, 0));
+  VK_CALL(vkBeginCommandBuffer(cmd_buffer, &begin_info));
+
+  // acquire half of the release record() ended with, the submission waits on
+  // copied() at all commands, which this barrier chains onto
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.srcQueueFamilyIndex = src_family;
+  barrier.dstQueueFamilyIndex = compute_family;
+  barrier.buffer = raw[slot];
+  barrier.size = VK_WHOLE_SIZE;
+
+  // clang-format off
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+  // clang-format on
+
+  record_dispatch(cmd_buffer, slot);
+
+  VK_CALL(vkEndCommandBuffer(cmd_buffer));
+  return cmd_buffer;
+}
+
+void readback_converter_t::record_dispatch(VkCommandBuffer cmd_buffer,
+                                           const uint32_t slot) const {
+  const auto word_count = static_cast<uint32_t>(output_size / 4);
+
+  convert_constants_t constants = {};
+  constants.origin[0] = region.offset.x;
+  constants.origin[1] = region.offset.y;
+  constants.source_width = target.width;
+  constants.scale = scale;
+  constants.extent[0] = output_extent.width;
+  constants.extent[1] = output_extent.height;
+  constants.layout = static_cast<uint32_t>(layout);
+  constants.swap_rb = swap_rb ? 1 : 0;
+  constants.word_count = word_count;
+
+  // clang-format off
+  vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_sets[slot], 0, nullptr);
+  vkCmdPushConstants(cmd_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+  vkCmdDispatch(cmd_buffer, groups.width, groups.height, 1);
+
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = outputs[slot];
+  barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+  // clang-format on
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.hpp"
+#include "readback.hpp"
+
+// crops, downscales and repacks rendered frames on the gpu so only the bytes
+// the consumer asked for cross to host memory
+//
+// the image is copied as is into a device local buffer first, which keeps the
+// render target free of storage or sampled usage and of srgb decoding, then a
+// compute pass writes the readback layout into the frame slot's buffer
+//
+// each frame slot has its own device local copy; with a dedicated compute
+// family the copy is released to it and the conversion is recorded into the
+// converter's command buffer for the slot, submitted to the compute queue
+// after waiting on copied() for the frame
+class readback_converter_t {
+public:
+  readback_converter_t(VkDevice, gpu_allocator_t &, VkPipelineCache,
+                       const VkPhysicalDeviceLimits &,
+                       const uint32_t queue_family_index,
+                       const uint32_t compute_family_index,
+                       const VkExtent2D target, const VkFormat,
+                       const VkRect2D region, const uint32_t scale,
+                       const readback_layout_t,
+                       std::span<const readback_slot_t> slots);
+  ~readback_converter_t();
+
+  readback_converter_t(const readback_converter_t &) = delete;
+  readback_converter_t &operator=(const readback_converter_t &) = delete;
+
+  // output extent after crop and scale
+  VkExtent2D extent() const { return output_extent; }
+
+  // whether conversions run on the compute queue
+  bool async() const { return src_family != compute_family; }
+
+  // frame n's copy is released once value n + 1 is signaled, by the
+  // submission record() went into
+  VkSemaphore copied() const { return semaphore; }
+
+  // copy and convert into a slot's buffer for the host, the image must be in
+  // TRANSFER_SRC_OPTIMAL layout and is transitioned to final_layout, when
+  // async only the copy is recorded
+  void record(VkCommandBuffer, VkImage, const uint32_t slot,
+              const VkImageLayout final_layout) const;
+
+  // when async, the slot's conversion for the compute queue, reused once the
+  // frame that last submitted it has completed
+  VkCommandBuffer record_async(const uint32_t slot) const;
+
+private:
+  void record_dispatch(VkCommandBuffer, const uint32_t slot) const;
+
+  VkDevice device;
+  gpu_allocator_t &allocator;
+  const uint32_t src_family, compute_family;
+  const VkExtent2D target;
+  const VkRect2D region;
+  const uint32_t scale;
+  const readback_layout_t layout;
+  const bool swap_rb;
+  const VkExtent2D output_extent;
+  const VkDeviceSize output_size;
+  VkExtent2D groups = {}; // one invocation per output word
+
+  std::vector<VkBuffer> raw = {}; // per slot device local copies
+  std::vector<gpu_allocation_t> raw_memory = {};
+  std::vector<VkBuffer> outputs = {}; // slot buffers
+
+  // async only
+  VkSemaphore semaphore = {};
+  VkCommandPool cmd_pool = {};
+  std::vector<VkCommandBuffer> cmd_buffers = {}; // per slot
+
+  VkDescriptorSetLayout set_layout = {};
+  VkDescriptorPool descriptor_pool = {};
+  std::vector<VkDescriptorSet> descriptor_sets = {}; // per slot
+  VkPipelineLayout pipeline_layout = {};
+  VkPipeline pipeline = {};
+};
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <array>
+
+#include "globals.hpp"
+
+#include "shader_registry.hpp"
+
+namespace {
+
+// generated by glslangValidator -x at build time, see CMakeLists.txt
+constexpr uint32_t default_vert[] = {
+#include "shaders/default.vert.spv.inc"
+};
+
+constexpr uint32_t default_frag[] = {
+#include "shaders/default.frag.spv.inc"
+};
+
+constexpr uint32_t untextured_frag[] = {
+#include "shaders/untextured.frag.spv.inc"
+};
+
+constexpr uint32_t cull_comp[] = {
+#include "shaders/cull.comp.spv.inc"
+};
+
+constexpr uint32_t cull_draws_comp[] = {
+#include "shaders/cull_draws.comp.spv.inc"
+};
+
+constexpr uint32_t readback_convert_comp[] = {
+#include "shaders/readback_convert.comp.spv.inc"
+};
+
+constexpr std::array shaders{
+    shader_binary_t{"default.vert", default_vert},
+    shader_binary_t{"default.frag", default_frag},
+    shader_binary_t{"untextured.frag", untextured_frag},
+    shader_binary_t{"cull.comp", cull_comp},
+    shader_binary_t{"cull_draws.comp", cull_draws_comp},
+    shader_binary_t{"readback_convert.comp", readback_convert_comp},
+};
+
+} // namespace
+
+shader_binary_t find_shader(const std::string_view name) {
+  const auto shader =
+      std::find_if(shaders.begin(), shaders.end(),
+                   [&](const auto &shader) { return shader.name == name; });
+
+  return shader != shaders.end() ? *shader : shader_binary_t{name, {}};
+}
+
+VkPipeline create_compute_pipeline(VkDevice device, VkPipelineCache cache,
+                                   VkPipelineLayout layout,
+                                   const std::string_view name) {
+  const auto shader = find_shader(name);
+  ASSERT(!shader.code.empty());
+
+  VkShaderModuleCreateInfo module_info = {};
+  module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  module_info.codeSize = shader.code.size_bytes();
+  module_info.pCode = shader.code.data();
+
+  VkShaderModule module = {};
+  VK_CALL(vkCreateShaderModule(device, &module_info, nullptr, &module));
+
+  VkComputePipelineCreateInfo pipeline_info = {};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = module;
+  pipeline_info.stage.pName = "main";
+  pipeline_info.layout = layout;
+
+  VkPipeline pipeline = {};
+  VK_CALL(vkCreateComputePipelines(device, cache, 1, &pipeline_info, nullptr,
+                                   &pipeline));
+
+  vkDestroyShaderModule(device, module, nullptr);
+  return pipeline;
+}
+
+VkExtent2D dispatch_groups(const uint32_t groups,
+                           const VkPhysicalDeviceLimits &limits) {
+  ASSERT(groups > 0);
+
+  const auto width = std::min(groups, limits.maxComputeWorkGroupCount[0]);
+  const auto height = (groups + width - 1) / width;
+  ASSERT(height <= limits.maxComputeWorkGroupCount[1]);
+
+  return {width, height};
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include <vulkan/vulkan.h>
+
+// spir-v compiled at build time and embedded into the binary, looked up by
+// source file name, eg: default.vert
+struct shader_binary_t {
+  std::string_view name = {};
+  std::span<const uint32_t> code = {};
+};
+
+// empty code when no shader with that name was embedded
+shader_binary_t find_shader(const std::string_view);
+
+// compute pipeline running an embedded shader's main
+VkPipeline create_compute_pipeline(VkDevice, VkPipelineCache, VkPipelineLayout,
+                                   const std::string_view name);
+
+// workgroups covering groups along x, wrapped onto y past the device's x
+// limit, shaders rebuild the flat group index from gl_NumWorkGroups.x
+VkExtent2D dispatch_groups(const uint32_t groups,
+                           const VkPhysicalDeviceLimits &);
@@ -1,12 +1,52 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) flat in uint fragMaterial;
+layout(location = 2) in vec2 fragUv;
 
 layout(location = 0) out vec4 outColor;
 
+// written per frame, selected with dynamic offsets
+layout(set = 0, binding = 0) uniform frame_t {
+    float time;
+    uint frame;
+    uint material_count;
+} frame_data;
+
+struct material_t {
+    vec4 tint;
+    uint texture_id; // into textures, 0 is white
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer materials_t {
+    material_t materials[];
+};
+
+// resolved when the pipeline is built, see pipeline_state.hpp
+layout(constant_id = 0) const bool textured = true;
+layout(constant_id = 1) const uint shading = 0u; // 1 shows texture coordinates
+
+// bindless, each view covers the levels streamed in so far
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    material_t material =
+        materials[min(fragMaterial, frame_data.material_count - 1u)];
+
+    if (shading == 1u) {
+        outColor = vec4(fragUv, 0.0, 1.0);
+        return;
+    }
+
+    // instances of a draw may use different textures
+    vec3 texel = vec3(1.0);
+    if (textured) {
+        uint texture_id = material.texture_id;
+        texel = texture(textures[nonuniformEXT(texture_id)], fragUv).rgb;
+    }
+    outColor = vec4(fragColor * material.tint.rgb * texel, 1.0);
 }
 
 // vim: ft=glsl :
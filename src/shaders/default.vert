@@ -3,7 +3,20 @@
 
 layout(location = 0) in vec2 inPosition;
 
+// per instance
+layout(location = 1) in vec4 inModel; // column major rotation and scale
+layout(location = 2) in vec2 inOffset;
+layout(location = 3) in vec4 inColor;
+layout(location = 4) in uint inMaterial;
+
+layout(push_constant) uniform constants_t {
+    vec4 view; // xy center, zoom
+    vec4 tile; // xy offset, zw scale
+} constants;
+
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) flat out uint fragMaterial;
+layout(location = 2) out vec2 fragUv;
 
 vec3 colors[3] = vec3[](
     vec3(1.0, 0.0, 0.0),
@@ -12,8 +25,12 @@ vec3 colors[3] = vec3[](
 );
 
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = colors[(gl_VertexIndex + gl_InstanceIndex) % 3];
+    vec2 world = mat2(inModel.xy, inModel.zw) * inPosition + inOffset;
+    vec2 clip = (world - constants.view.xy) * constants.view.z;
+    gl_Position = vec4((clip - constants.tile.xy) * constants.tile.zw, 0.0, 1.0);
+    fragColor = mix(colors[gl_VertexIndex % 3], inColor.rgb, 0.5);
+    fragMaterial = inMaterial;
+    fragUv = inPosition + 0.5; // planar, one repeat per unit of mesh
 }
 
 // vim: ft=glsl :
@@ -0,0 +1,45 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// default.frag without the bindless textures of set 1, for devices without
+// descriptor indexing where the runtime array alone fails module creation
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) flat in uint fragMaterial;
+layout(location = 2) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+// written per frame, selected with dynamic offsets
+layout(set = 0, binding = 0) uniform frame_t {
+    float time;
+    uint frame;
+    uint material_count;
+} frame_data;
+
+struct material_t {
+    vec4 tint;
+    uint texture_id; // unused, there are no textures
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer materials_t {
+    material_t materials[];
+};
+
+// resolved when the pipeline is built, see pipeline_state.hpp, textured
+// (constant_id 0) is ignored
+layout(constant_id = 1) const uint shading = 0u; // 1 shows texture coordinates
+
+void main() {
+    material_t material =
+        materials[min(fragMaterial, frame_data.material_count - 1u)];
+
+    if (shading == 1u) {
+        outColor = vec4(fragUv, 0.0, 1.0);
+        return;
+    }
+
+    outColor = vec4(fragColor * material.tint.rgb, 1.0);
+}
+
+// vim: ft=glsl :
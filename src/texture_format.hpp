@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// .ctex, little endian srgb rgba8 textures with their full mip chain
+//
+//   ctex_header_t                        64 bytes
+//   ctex_level_t per level               16 bytes each, level 0 is largest
+//   level texels at each level's offset  width * height * 4 bytes
+//
+// levels are stored smallest first so streaming them lowest resolution first
+// reads the file front to back, each starts on a ctex_alignment boundary,
+// see tools/ppm_to_ctex.cpp
+constexpr uint32_t ctex_magic = 0x7865'7463; // "ctex"
+constexpr uint32_t ctex_version = 1;
+constexpr uint64_t ctex_alignment = 64;
+constexpr uint32_t ctex_max_levels = 16;
+
+struct ctex_header_t {
+  uint32_t magic = ctex_magic;
+  uint32_t version = ctex_version;
+  uint32_t width = 0, height = 0; // of level 0
+  uint32_t level_count = 0;       // down to 1x1
+  uint32_t reserved[11] = {};
+};
+
+struct ctex_level_t {
+  uint32_t width = 0, height = 0;
+  uint64_t offset = 0; // from the start of the file
+};
+
+static_assert(sizeof(ctex_header_t) == 64);
+static_assert(sizeof(ctex_level_t) == 16);
+
+constexpr uint64_t ctex_align(const uint64_t offset) {
+  return (offset + ctex_alignment - 1) & ~(ctex_alignment - 1);
+}
@@ -0,0 +1,568 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "globals.hpp"
+
+#include "texture_streamer.hpp"
+
+namespace {
+
+constexpr VkFormat texture_format = VK_FORMAT_R8G8B8A8_SRGB;
+constexpr VkDeviceSize texel_size = 4;
+
+// why the header cannot be used, null when it can
+const char *check_header(const std::byte *data, const size_t size) {
+  const auto &header = *reinterpret_cast<const ctex_header_t *>(data);
+  if (header.magic != ctex_magic)
+    return "not a ctex file";
+
+  if (header.version != ctex_version)
+    return "unsupported version";
+
+  if (header.width == 0 || header.height == 0 || header.level_count == 0 ||
+      header.level_count > ctex_max_levels)
+    return "bad dimensions";
+
+  // every level halves the one above down to 1x1, and not one level more
+  if (header.level_count !=
+      std::bit_width(std::max(header.width, header.height)))
+    return "bad level count";
+
+  if (size < sizeof(ctex_header_t) +
+                 header.level_count * sizeof(ctex_level_t))
+    return "truncated";
+
+  const auto *levels =
+      reinterpret_cast<const ctex_level_t *>(data + sizeof(ctex_header_t));
+  for (uint32_t index = 0; index < header.level_count; index += 1) {
+    const auto &level = levels[index];
+    if (level.width != std::max(header.width >> index, 1u) ||
+        level.height != std::max(header.height >> index, 1u))
+      return "bad level dimensions";
+
+    if (level.offset % ctex_alignment != 0)
+      return "misaligned level";
+
+    const auto bytes = uint64_t{level.width} * level.height * texel_size;
+    if (level.offset > size || bytes > size - level.offset)
+      return "truncated";
+  }
+
+  return nullptr;
+}
+
+} // namespace
+
+mapped_texture_t::mapped_texture_t(const std::byte *data, const size_t size)
+    : data{data}, size_bytes{size} {}
+
+mapped_texture_t::~mapped_texture_t() {
+  munmap(const_cast<std::byte *>(data), size_bytes);
+}
+
+const ctex_header_t &mapped_texture_t::header() const {
+  return *reinterpret_cast<const ctex_header_t *>(data);
+}
+
+const ctex_level_t &mapped_texture_t::level(const uint32_t index) const {
+  return reinterpret_cast<const ctex_level_t *>(
+      data + sizeof(ctex_header_t))[index];
+}
+
+std::span<const std::byte>
+mapped_texture_t::texels(const uint32_t index) const {
+  const auto &entry = level(index);
+  return {data + entry.offset,
+          uint64_t{entry.width} * entry.height * texel_size};
+}
+
+VkDeviceSize mapped_texture_t::size() const {
+  VkDeviceSize bytes = 0;
+  for (uint32_t index = 0; index < header().level_count; index += 1)
+    bytes += texels(index).size();
+
+  return bytes;
+}
+
+std::unique_ptr<mapped_texture_t>
+map_texture(const std::filesystem::path &path) {
+  const auto fail = [&](const char *reason) {
+    std::cout << "texture: " << path.string() << ": " << reason << std::endl;
+    return nullptr;
+  };
+
+  const auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return fail("cannot open");
+
+  struct stat info = {};
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(ctex_header_t)) {
+    close(fd);
+    return fail("too small");
+  }
+
+  const auto size = static_cast<size_t>(info.st_size);
+  auto *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return fail("cannot map");
+
+  // levels are streamed front to back, and again after an eviction
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  auto texture = std::make_unique<mapped_texture_t>(
+      static_cast<const std::byte *>(data), size);
+  if (const auto reason =
+          check_header(static_cast<const std::byte *>(data), size))
+    return fail(reason);
+
+  return texture;
+}
+
+texture_streamer_t::texture_streamer_t(VkDevice device,
+                                       gpu_allocator_t &allocator,
+                                       upload_context_t &uploads,
+                                       const VkPhysicalDeviceLimits &limits,
+                                       const uint32_t frame_count,
+                                       const VkDeviceSize budget)
+    : device{device}, allocator{allocator}, uploads{uploads}, budget{budget},
+      max_dimension{limits.maxImageDimension2D} {
+  ASSERT(frame_count > 0);
+
+  // ids that were never loaded are left unwritten, update after bind raises
+  // the descriptor limits to what bindless arrays need
+  {
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = max_textures;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    const VkDescriptorBindingFlags binding_flags =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {};
+    flags_info.sType =
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flags_info.bindingCount = 1;
+    flags_info.pBindingFlags = &binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &flags_info;
+    layout_info.flags =
+        VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = 1;
+    layout_info.pBindings = &binding;
+    VK_CALL(vkCreateDescriptorSetLayout(device, &layout_info, nullptr,
+                                        &set_layout));
+  }
+
+  {
+    const VkDescriptorPoolSize pool_size = {
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_textures * frame_count};
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = frame_count;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    VK_CALL(vkCreateDescriptorPool(device, &pool_info, nullptr,
+                                   &descriptor_pool));
+
+    const std::vector<VkDescriptorSetLayout> layouts(frame_count, set_layout);
+    descriptor_sets.resize(frame_count);
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool;
+    alloc_info.descriptorSetCount = frame_count;
+    alloc_info.pSetLayouts = layouts.data();
+    VK_CALL(vkAllocateDescriptorSets(device, &alloc_info,
+                                     descriptor_sets.data()));
+
+    written.assign(frame_count, std::vector<VkImageView>(max_textures));
+  }
+
+  // shared by every texture, the views limit which levels can be sampled
+  {
+    VkSamplerCreateInfo sampler_info = {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CALL(vkCreateSampler(device, &sampler_info, nullptr, &sampler));
+  }
+
+  // the default texture, resident for good and never counted
+  {
+    auto texture = std::make_unique<texture_t>();
+
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = texture_format;
+    image_info.extent = {1, 1, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage =
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    texture->memory = allocator.create_image(
+        image_info, memory_usage_t::gpu_only, texture->image);
+
+    const std::array<std::byte, texel_size> white = {
+        std::byte{255}, std::byte{255}, std::byte{255}, std::byte{255}};
+    uploads.upload_image(texture->image, 0, {1, 1}, white);
+    texture->ticket = uploads.flush();
+
+    texture->state = state_t::resident;
+    texture->streamed = 1;
+    texture->done = true;
+    texture->view = create_view(texture->image, 0, 1);
+    texture->view_levels = 1;
+    textures.push_back(std::move(texture));
+  }
+
+  thread = std::thread{&texture_streamer_t::run, this};
+}
+
+texture_streamer_t::~texture_streamer_t() {
+  {
+    const std::scoped_lock lock{mutex};
+    stopping = true;
+  }
+
+  wake.notify_all();
+  thread.join();
+
+  for (uint32_t id = 0; id < textures.size(); id += 1) {
+    uploads.wait(textures[id]->ticket);
+    release(id);
+  }
+
+  for (const auto &entry : retired)
+    vkDestroyImageView(device, entry.view, nullptr);
+
+  vkDestroySampler(device, sampler, nullptr);
+  vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+  vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+}
+
+uint32_t texture_streamer_t::load(const std::filesystem::path &path) {
+  if (textures.size() == max_textures) {
+    std::cout << "texture: " << path.string() << ": out of ids" << std::endl;
+    return default_texture;
+  }
+
+  auto file = map_texture(path);
+  if (!file)
+    return default_texture;
+
+  // valid files go up to ctex_max_levels, beyond what many devices allow,
+  // and image creation on the streaming thread must not fail
+  const auto &header = file->header();
+  if (std::max(header.width, header.height) > max_dimension) {
+    std::cout << "texture: " << path.string()
+              << ": larger than the device allows" << std::endl;
+    return default_texture;
+  }
+
+  // a transfer queue that copies only whole levels needs level 0 to fit the
+  // staging ring
+  if (!uploads.fits_image({header.width, header.height})) {
+    std::cout << "texture: " << path.string()
+              << ": larger than the upload ring allows" << std::endl;
+    return default_texture;
+  }
+
+  // could never be made resident, and would hold up every load after it
+  if (file->size() > budget) {
+    std::cout << "texture: " << path.string() << ": larger than the budget"
+              << std::endl;
+    return default_texture;
+  }
+
+  auto texture = std::make_unique<texture_t>();
+  texture->size = file->size();
+  texture->file = std::move(file);
+
+  const auto id = static_cast<uint32_t>(textures.size());
+  textures.push_back(std::move(texture));
+  queued.push_back(id);
+  return id;
+}
+
+void texture_streamer_t::begin_frame(const uint64_t frame,
+                                     const uint64_t completed) {
+  const auto slot = static_cast<uint32_t>(frame % descriptor_sets.size());
+  const auto frame_count = descriptor_sets.size();
+
+  // every set has been rewritten since, and the frames before are done
+  std::erase_if(retired, [&](const retired_view_t &entry) {
+    if (completed < entry.frame + frame_count)
+      return false;
+
+    vkDestroyImageView(device, entry.view, nullptr);
+    return true;
+  });
+
+  // levels flushed before this point are acquired by this frame, grow the
+  // views to cover them
+  for (uint32_t id = 1; id < textures.size(); id += 1) {
+    auto &texture = *textures[id];
+    if (texture.state != state_t::streaming)
+      continue;
+
+    const auto done = texture.done.load(std::memory_order_acquire);
+    const auto streamed = texture.streamed.load(std::memory_order_acquire);
+    if (streamed > texture.view_levels) {
+      if (texture.view != VK_NULL_HANDLE)
+        retired.push_back({texture.view, frame, id});
+
+      const auto level_count = texture.file->header().level_count;
+      texture.view =
+          create_view(texture.image, level_count - streamed, streamed);
+      texture.view_levels = streamed;
+    }
+
+    // with a transfer queue the last level is only acquired by this frame,
+    // the image must outlive that acquire
+    if (done) {
+      texture.state = state_t::resident;
+      texture.acquired = frame;
+    }
+  }
+
+  // oldest request first, a load that does not fit holds up the rest
+  while (!queued.empty()) {
+    auto &texture = *textures[queued.front()];
+    if (texture.state != state_t::queued) {
+      queued.pop_front();
+      continue;
+    }
+
+    if (resident + texture.size > budget && !evict(completed, texture.size))
+      break;
+
+    resident += texture.size;
+    texture.state = state_t::streaming;
+    queued.pop_front();
+
+    {
+      const std::scoped_lock lock{mutex};
+      pending.push_back(&texture);
+    }
+    wake.notify_one();
+  }
+
+  // the frame that last used this slot's set is done with it
+  std::vector<VkDescriptorImageInfo> image_infos = {};
+  std::vector<uint32_t> ids = {};
+  for (uint32_t id = 0; id < textures.size(); id += 1) {
+    const auto view = textures[id]->view;
+    if (view == VK_NULL_HANDLE || written[slot][id] == view)
+      continue;
+
+    image_infos.push_back(
+        {sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+    ids.push_back(id);
+    written[slot][id] = view;
+  }
+
+  std::vector<VkWriteDescriptorSet> writes{ids.size()};
+  for (size_t index = 0; index < writes.size(); index += 1) {
+    writes[index].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[index].dstSet = descriptor_sets[slot];
+    writes[index].dstBinding = 0;
+    writes[index].dstArrayElement = ids[index];
+    writes[index].descriptorCount = 1;
+    writes[index].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[index].pImageInfo = &image_infos[index];
+  }
+
+  if (!writes.empty())
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()),
+                           writes.data(), 0, nullptr);
+}
+
+uint32_t texture_streamer_t::use(const uint32_t id, const uint64_t frame) {
+  if (id == default_texture || id >= textures.size())
+    return default_texture;
+
+  auto &texture = *textures[id];
+  texture.last_used = frame;
+
+  // streamed back in, drawn with the default until then
+  if (texture.state == state_t::evicted) {
+    texture.state = state_t::queued;
+    queued.push_back(id);
+  }
+
+  return texture.view != VK_NULL_HANDLE ? id : default_texture;
+}
+
+void texture_streamer_t::bind(VkCommandBuffer cmd_buffer,
+                              const VkPipelineBindPoint bind_point,
+                              VkPipelineLayout pipeline_layout,
+                              const uint32_t slot) const {
+  // clang-format off
+  vkCmdBindDescriptorSets(cmd_buffer, bind_point, pipeline_layout, 1, 1, &descriptor_sets[slot], 0, nullptr);
+  // clang-format on
+}
+
+void texture_streamer_t::run() {
+  while (true) {
+    texture_t *texture = nullptr;
+    {
+      std::unique_lock lock{mutex};
+      wake.wait(lock, [this] { return stopping || !pending.empty(); });
+      if (stopping)
+        return;
+
+      texture = pending.front();
+      pending.pop_front();
+    }
+
+    stream(*texture);
+  }
+}
+
+void texture_streamer_t::stream(texture_t &texture) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto &header = texture.file->header();
+
+  VkImageCreateInfo image_info = {};
+  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType = VK_IMAGE_TYPE_2D;
+  image_info.format = texture_format;
+  image_info.extent = {header.width, header.height, 1};
+  image_info.mipLevels = header.level_count;
+  image_info.arrayLayers = 1;
+  image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage =
+      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  texture.memory = allocator.create_image(image_info, memory_usage_t::gpu_only,
+                                          texture.image);
+
+  // each level is its own batch so the render thread can start sampling it
+  // as soon as it lands, pages are faulted in by the copy into staging
+  for (uint32_t streamed = 1; streamed <= header.level_count; streamed += 1) {
+    const auto level = header.level_count - streamed;
+    const auto &entry = texture.file->level(level);
+    uploads.upload_image(texture.image, level, {entry.width, entry.height},
+                         texture.file->texels(level));
+
+    texture.ticket = uploads.flush();
+    texture.streamed.store(streamed, std::memory_order_release);
+
+    {
+      const std::scoped_lock lock{mutex};
+      if (stopping)
+        return;
+    }
+  }
+
+  texture.done.store(true, std::memory_order_release);
+
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << "texture: " << header.width << "x" << header.height << ", "
+            << header.level_count << " levels staged in " << elapsed.count()
+            << " ms" << std::endl;
+}
+
+bool texture_streamer_t::evict(const uint64_t completed,
+                               const VkDeviceSize needed) {
+  while (resident + needed > budget) {
+    // least recently used of the textures no frame in flight has used or
+    // acquired, and whose copies have landed
+    uint32_t victim = 0;
+    for (uint32_t id = 1; id < textures.size(); id += 1) {
+      const auto &texture = *textures[id];
+      if (texture.state != state_t::resident ||
+          texture.last_used >= completed || texture.acquired >= completed ||
+          !uploads.complete(texture.ticket))
+        continue;
+
+      if (victim == 0 || texture.last_used < textures[victim]->last_used)
+        victim = id;
+    }
+
+    if (victim == 0)
+      return false;
+
+    resident -= textures[victim]->size;
+    release(victim);
+    textures[victim]->state = state_t::evicted;
+  }
+
+  return true;
+}
+
+void texture_streamer_t::release(const uint32_t id) {
+  auto &texture = *textures[id];
+
+  // no set may keep a handle that a later view could reuse
+  for (auto &views : written)
+    views[id] = VK_NULL_HANDLE;
+
+  std::erase_if(retired, [&](const retired_view_t &entry) {
+    if (entry.id != id)
+      return false;
+
+    vkDestroyImageView(device, entry.view, nullptr);
+    return true;
+  });
+
+  if (texture.view != VK_NULL_HANDLE)
+    vkDestroyImageView(device, texture.view, nullptr);
+
+  if (texture.image != VK_NULL_HANDLE)
+    allocator.destroy_image(texture.image, texture.memory);
+
+  texture.view = VK_NULL_HANDLE;
+  texture.view_levels = 0;
+  texture.image = VK_NULL_HANDLE;
+  texture.ticket = 0;
+  texture.streamed = 0;
+  texture.done = false;
+}
+
+VkImageView texture_streamer_t::create_view(VkImage image,
+                                            const uint32_t first_level,
+                                            const uint32_t level_count) const {
+  VkImageViewCreateInfo view_info = {};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image = image;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = texture_format;
+  view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, first_level,
+                                level_count, 0, 1};
+
+  VkImageView view = {};
+  VK_CALL(vkCreateImageView(device, &view_info, nullptr, &view));
+  return view;
+}
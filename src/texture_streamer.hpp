@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.hpp"
+#include "texture_format.hpp"
+#include "upload.hpp"
+
+// a .ctex file mapped read only, the levels point straight into the mapping
+class mapped_texture_t {
+public:
+  mapped_texture_t(const std::byte *data, const size_t size);
+  ~mapped_texture_t();
+
+  mapped_texture_t(const mapped_texture_t &) = delete;
+  mapped_texture_t &operator=(const mapped_texture_t &) = delete;
+
+  const ctex_header_t &header() const;
+  const ctex_level_t &level(const uint32_t) const;
+  std::span<const std::byte> texels(const uint32_t level) const;
+
+  // bytes of every level once resident
+  VkDeviceSize size() const;
+
+private:
+  const std::byte *data;
+  size_t size_bytes;
+};
+
+// null when the file cannot be mapped or its header does not check out
+std::unique_ptr<mapped_texture_t> map_texture(const std::filesystem::path &);
+
+// every texture is one entry of a sampler2D array in set 1, indexed by id,
+// id 0 is a white texel drawn in place of textures that are not resident
+//
+// textures are streamed in on a background thread a level at a time,
+// smallest first, each level is flushed on its own and the texture's view
+// grows to cover it once its copies are visible to the next frame, so a
+// texture sharpens as it loads and no descriptor points at a level in
+// UNDEFINED or TRANSFER_DST layout
+//
+// there is one set per frame in flight, a slot's set is rewritten only when
+// the frame that last used it has completed, so no descriptor is updated
+// while a pending frame may read it
+//
+// resident textures are kept under the budget by evicting the least recently
+// used ones the gpu is done with, a texture used again after its eviction is
+// streamed back in, loads wait until enough can be evicted
+//
+// everything but the streaming thread runs on the render thread
+class texture_streamer_t {
+public:
+  static constexpr uint32_t max_textures = 1024;
+  static constexpr uint32_t default_texture = 0;
+
+  texture_streamer_t(VkDevice, gpu_allocator_t &, upload_context_t &,
+                     const VkPhysicalDeviceLimits &,
+                     const uint32_t frame_count, const VkDeviceSize budget);
+
+  // joins the thread and destroys every texture once its copies complete, the
+  // consumer must be done with them
+  ~texture_streamer_t();
+
+  texture_streamer_t(const texture_streamer_t &) = delete;
+  texture_streamer_t &operator=(const texture_streamer_t &) = delete;
+
+  // set 1 of every pipeline sampling textures
+  VkDescriptorSetLayout layout() const { return set_layout; }
+
+  // the id to draw path with, queued for streaming, default_texture when it
+  // cannot be mapped or there are no free ids
+  uint32_t load(const std::filesystem::path &);
+
+  // once per frame before any use(), completed is the number of frames the
+  // gpu has finished, ie: the frame scheduler's completed value
+  //
+  // grows the views of streamed levels, evicts and queues loads, and brings
+  // the frame slot's set up to date
+  void begin_frame(const uint64_t frame, const uint64_t completed);
+
+  // the id shaders may sample this frame for a loaded texture, default_texture
+  // until its first level is resident
+  uint32_t use(const uint32_t id, const uint64_t frame);
+
+  void bind(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout,
+            const uint32_t slot) const;
+
+  VkDeviceSize resident_bytes() const { return resident; }
+
+private:
+  enum class state_t { queued, streaming, resident, evicted };
+
+  struct texture_t {
+    std::unique_ptr<mapped_texture_t> file = {}; // null for the default
+    state_t state = state_t::queued;
+    VkDeviceSize size = 0;  // counted against the budget while loaded
+    uint64_t last_used = 0; // frame, 0 when never used
+    uint64_t acquired = 0;  // frame acquiring the last level once resident
+
+    // written by the streaming thread, image and memory before the first
+    // level is published
+    VkImage image = {};
+    gpu_allocation_t memory = {};
+    upload_ticket_t ticket = 0;         // of the last level's flush
+    std::atomic<uint32_t> streamed = 0; // levels flushed, smallest first
+    std::atomic<bool> done = false;     // every level flushed
+
+    VkImageView view = {}; // over the resident levels
+    uint32_t view_levels = 0;
+  };
+
+  void run();
+  void stream(texture_t &);
+  bool evict(const uint64_t completed, const VkDeviceSize needed);
+  void release(const uint32_t id);
+  VkImageView create_view(VkImage, const uint32_t first_level,
+                          const uint32_t level_count) const;
+
+  VkDevice device;
+  gpu_allocator_t &allocator;
+  upload_context_t &uploads;
+  const VkDeviceSize budget;
+  const uint32_t max_dimension; // maxImageDimension2D
+
+  VkDescriptorSetLayout set_layout = {};
+  VkDescriptorPool descriptor_pool = {};
+  VkSampler sampler = {};
+  std::vector<VkDescriptorSet> descriptor_sets = {}; // per frame in flight
+  std::vector<std::vector<VkImageView>> written = {}; // per set and id
+
+  std::vector<std::unique_ptr<texture_t>> textures = {}; // indexed by id
+  std::deque<uint32_t> queued = {}; // waiting for room in the budget
+  VkDeviceSize resident = 0;
+
+  // views replaced by a larger one, destroyed once every set has been
+  // rewritten and no frame still in flight may read them
+  struct retired_view_t {
+    VkImageView view = {};
+    uint64_t frame = 0; // replaced at
+    uint32_t id = 0;
+  };
+  std::vector<retired_view_t> retired = {};
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<texture_t *> pending = {}; // handed to the streaming thread
+  bool stopping = false;
+  std::thread thread;
+};
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "globals.hpp"
+
+#include "tiling.hpp"
+
+uint32_t tile_grid_t::columns() const {
+  return (image.width + tile.width - 1) / tile.width;
+}
+
+uint32_t tile_grid_t::rows() const {
+  return (image.height + tile.height - 1) / tile.height;
+}
+
+uint32_t tile_grid_t::count() const {
+  if (tile.width == 0 || tile.height == 0)
+    return 0;
+
+  return columns() * rows();
+}
+
+VkRect2D tile_grid_t::rect(const uint32_t index) const {
+  const auto x = index % columns() * tile.width;
+  const auto y = index / columns() * tile.height;
+
+  return {{static_cast<int32_t>(x), static_cast<int32_t>(y)},
+          {std::min(tile.width, image.width - x),
+           std::min(tile.height, image.height - y)}};
+}
+
+void set_tile_projection(const tile_grid_t &grid, const uint32_t index,
+                         camera_t &camera) {
+  const auto rect = grid.rect(index);
+  const double image[2] = {double(grid.image.width), double(grid.image.height)};
+  const double tile[2] = {double(grid.tile.width), double(grid.tile.height)};
+  const double origin[2] = {double(rect.offset.x), double(rect.offset.y)};
+
+  // the tile's center in full image clip space, and the magnification that
+  // stretches the tile over the whole target
+  for (int axis = 0; axis < 2; axis += 1) {
+    camera.tile_offset[axis] =
+        static_cast<float>((2 * origin[axis] + tile[axis]) / image[axis] - 1);
+    camera.tile_scale[axis] = static_cast<float>(image[axis] / tile[axis]);
+  }
+}
+
+tile_writer_t::tile_writer_t(const std::filesystem::path &path,
+                             const VkExtent2D image)
+    : file{path, std::ios::binary} {
+  grid.image = image;
+
+  if (!file) {
+    std::cout << "tiles: unable to open " << path.string() << std::endl;
+    failed = true;
+    return;
+  }
+
+  file << "P6\n" << image.width << " " << image.height << "\n255\n";
+}
+
+void tile_writer_t::write(const readback_frame_t &frame) {
+  if (failed || frame.layout != readback_layout_t::rgb8) {
+    failed = true;
+    return;
+  }
+
+  if (next_tile == 0) {
+    grid.tile = frame.extent;
+    band.resize(size_t{grid.image.width} * grid.tile.height * 3);
+  }
+
+  if (next_tile >= grid.count())
+    return;
+
+  ASSERT(frame.extent.width == grid.tile.width &&
+         frame.extent.height == grid.tile.height);
+
+  // copy the part of the tile inside the image into its columns of the band
+  const auto rect = grid.rect(next_tile);
+  const auto tile_row = size_t{grid.tile.width} * 3;
+  const auto band_row = size_t{grid.image.width} * 3;
+  const auto row_bytes = size_t{rect.extent.width} * 3;
+
+  for (uint32_t y = 0; y < rect.extent.height; y += 1)
+    std::memcpy(band.data() + y * band_row + size_t(rect.offset.x) * 3,
+                frame.data.data() + y * tile_row, row_bytes);
+
+  next_tile += 1;
+
+  // the band is complete once its last column arrives
+  if (next_tile % grid.columns() == 0) {
+    file.write(reinterpret_cast<const char *>(band.data()),
+               static_cast<std::streamsize>(band_row * rect.extent.height));
+    failed = !file;
+  }
+}
+
+bool tile_writer_t::complete() const {
+  return !failed && grid.tile.width != 0 && next_tile == grid.count();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "instances.hpp"
+#include "readback.hpp"
+
+// splits an image into a row major grid of equally sized tiles, tiles on the
+// right and bottom edges hang over the image
+struct tile_grid_t {
+  VkExtent2D image = {};
+  VkExtent2D tile = {};
+
+  uint32_t columns() const;
+  uint32_t rows() const;
+  uint32_t count() const;
+
+  // part of the image a tile covers, offset within the image
+  VkRect2D rect(const uint32_t index) const;
+};
+
+// point the camera's tile transform at one tile, the full image still maps to
+// clip space as if it were rendered in one go
+void set_tile_projection(const tile_grid_t &, const uint32_t index,
+                         camera_t &);
+
+// assembles rgb8 tiles arriving in row major order into bands and appends
+// them to a binary ppm, only one band of the image is held in memory
+class tile_writer_t {
+public:
+  tile_writer_t(const std::filesystem::path &, const VkExtent2D image);
+
+  tile_writer_t(const tile_writer_t &) = delete;
+  tile_writer_t &operator=(const tile_writer_t &) = delete;
+
+  // tiles must arrive in index order, usable as the readback callback
+  void write(const readback_frame_t &);
+
+  // every tile arrived and was written
+  bool complete() const;
+
+private:
+  std::ofstream file;
+  tile_grid_t grid = {}; // tile extent is taken from the first frame
+  uint32_t next_tile = 0;
+  bool failed = false;
+
+  std::vector<std::byte> band = {}; // one row of tiles, image width wide
+};
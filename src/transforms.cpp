@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+
+#include "globals.hpp"
+
+#include "transforms.hpp"
+
+namespace {
+
+// instances per batch, every loop over a batch is branch free with a fixed
+// trip count so it compiles to vector instructions
+constexpr uint32_t lanes = 8;
+static_assert(transform_system_t::block_size % lanes == 0);
+
+// quarter turns split so multiples of them subtract exactly
+constexpr float two_over_pi = 0.636619772f;
+constexpr float half_pi_hi = 1.5703125f;
+constexpr float half_pi_mid = 4.837512969970703125e-4f;
+constexpr float half_pi_lo = 7.54978995489188216e-8f;
+
+// adding and subtracting 1.5 * 2^23 rounds to the nearest integer
+constexpr float round_bias = 12582912.0f;
+
+// sine and cosine of a batch, reduced to a quarter turn around zero and
+// approximated with the cephes minimax polynomials, a few ulp off std::sin
+// and std::cos for angles of up to a few thousand radians
+void sincos_lanes(const float *radians, float *sin, float *cos) {
+  for (uint32_t lane = 0; lane < lanes; lane += 1) {
+    const auto angle = radians[lane];
+    const auto turns = (angle * two_over_pi + round_bias) - round_bias;
+    const auto r = ((angle - turns * half_pi_hi) - turns * half_pi_mid) -
+                   turns * half_pi_lo;
+    const auto r2 = r * r;
+
+    const auto sin_r =
+        r + r * r2 *
+                (-1.6666654611e-1f +
+                 r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    const auto cos_r =
+        1.0f - 0.5f * r2 +
+        r2 * r2 *
+            (4.166664568298827e-2f +
+             r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+    // odd quarter turns swap sine and cosine, the second half of a turn
+    // flips their signs
+    const auto quadrant = static_cast<int32_t>(turns);
+    const auto s = quadrant & 1 ? cos_r : sin_r;
+    const auto c = quadrant & 1 ? sin_r : cos_r;
+    sin[lane] = quadrant & 2 ? -s : s;
+    cos[lane] = (quadrant + 1) & 2 ? -c : c;
+  }
+}
+
+} // namespace
+
+transform_system_t::transform_system_t(const uint32_t count) : count{count} {
+  // padded to whole blocks so batches never read past the end
+  const auto blocks = (count + block_size - 1) / block_size;
+  const auto padded = size_t{blocks} * block_size;
+
+  x.resize(padded);
+  y.resize(padded);
+  rotation.resize(padded);
+  scale.resize(padded, 1.0f);
+  color.resize(padded);
+  material.resize(padded);
+
+  dirty.resize((blocks + 63) / 64);
+  mark_all();
+}
+
+void transform_system_t::set_position(const uint32_t index, const float x,
+                                      const float y) {
+  ASSERT(index < count);
+  this->x[index] = x;
+  this->y[index] = y;
+  mark(index, 1);
+}
+
+void transform_system_t::set_rotation(const uint32_t index,
+                                      const float radians) {
+  ASSERT(index < count);
+  rotation[index] = radians;
+  mark(index, 1);
+}
+
+void transform_system_t::set_scale(const uint32_t index, const float scale) {
+  ASSERT(index < count);
+  this->scale[index] = scale;
+  mark(index, 1);
+}
+
+void transform_system_t::set_attributes(const uint32_t index,
+                                        const uint32_t color,
+                                        const uint32_t material) {
+  ASSERT(index < count);
+  this->color[index] = color;
+  this->material[index] = material;
+  mark(index, 1);
+}
+
+void transform_system_t::rotate(const uint32_t first, const uint32_t count,
+                                const float radians) {
+  ASSERT(first + count <= this->count);
+
+  // kept within a turn of zero so the sine and cosine stay accurate
+  constexpr auto turn = 6.28318531f;
+  for (uint32_t index = first; index < first + count; index += 1) {
+    const auto angle = rotation[index] + radians;
+    rotation[index] = angle - std::floor(angle / turn) * turn;
+  }
+
+  mark(first, count);
+}
+
+void transform_system_t::mark_all() { mark(0, count); }
+
+void transform_system_t::mark(const uint32_t first, const uint32_t count) {
+  if (count == 0)
+    return;
+
+  const auto last = (first + count - 1) / block_size;
+  for (auto block = first / block_size; block <= last; block += 1)
+    dirty[block / 64] |= uint64_t{1} << (block % 64);
+}
+
+transform_system_t::range_t
+transform_system_t::next_dirty(const uint32_t max_count) const {
+  const auto blocks = (count + block_size - 1) / block_size;
+  const auto is_dirty = [&](const uint32_t block) {
+    return (dirty[block / 64] >> (block % 64)) & 1;
+  };
+
+  // skip clean words a whole word at a time
+  uint32_t block = blocks;
+  for (uint32_t word = 0; word < dirty.size(); word += 1) {
+    if (dirty[word] != 0) {
+      block = word * 64 + std::countr_zero(dirty[word]);
+      break;
+    }
+  }
+
+  // the last block may be partial
+  const auto first = block * block_size;
+  uint32_t taken = 0;
+  while (block < blocks && is_dirty(block)) {
+    const auto length = std::min(block_size, count - block * block_size);
+    if (taken + length > max_count)
+      break;
+
+    taken += length;
+    block += 1;
+  }
+
+  if (taken == 0)
+    return {};
+
+  return {first, taken};
+}
+
+void transform_system_t::write(const range_t range, const float mesh_radius,
+                               const std::span<instance_t> instances,
+                               const std::span<instance_bounds_t> bounds) {
+  ASSERT(range.first % block_size == 0 && range.first + range.count <= count);
+  ASSERT(range.count % block_size == 0 || range.first + range.count == count);
+  ASSERT(instances.size() >= range.count && bounds.size() >= range.count);
+
+  // column major rotation and scale, the vertex shader adds the offset
+  for (uint32_t batch = 0; batch < range.count; batch += lanes) {
+    const auto first = range.first + batch;
+    const auto written = std::min(lanes, range.count - batch);
+
+    float sin[lanes], cos[lanes];
+    sincos_lanes(&rotation[first], sin, cos);
+
+    for (uint32_t lane = 0; lane < lanes; lane += 1) {
+      sin[lane] *= scale[first + lane];
+      cos[lane] *= scale[first + lane];
+    }
+
+    for (uint32_t lane = 0; lane < written; lane += 1) {
+      const auto index = first + lane;
+      auto &instance = instances[batch + lane];
+      instance.model[0] = cos[lane];
+      instance.model[1] = sin[lane];
+      instance.model[2] = -sin[lane];
+      instance.model[3] = cos[lane];
+      instance.offset[0] = x[index];
+      instance.offset[1] = y[index];
+      instance.color = color[index];
+      instance.material = material[index];
+
+      // rotation leaves a circle around the origin unchanged
+      bounds[batch + lane] = {
+          {x[index], y[index]}, std::abs(scale[index]) * mesh_radius, 0.0f};
+    }
+  }
+
+  const auto last = range.count == 0
+                        ? 0
+                        : (range.first + range.count - 1) / block_size + 1;
+  // neighbouring ranges may share a word
+  for (auto block = range.first / block_size; block < last; block += 1)
+    std::atomic_ref{dirty[block / 64]}.fetch_and(
+        ~(uint64_t{1} << (block % 64)), std::memory_order_relaxed);
+}
+
+transform_system_t create_instance_grid(const uint32_t count) {
+  const auto side =
+      static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+  const auto cell = 2.0f / static_cast<float>(side);
+
+  transform_system_t transforms{count};
+  for (uint32_t index = 0; index < count; index += 1) {
+    const auto column = index % side, row = index / side;
+
+    // the demo triangle spans one unit, leave a gap between cells
+    transforms.set_position(
+        index, -1.0f + cell * (static_cast<float>(column) + 0.5f),
+        -1.0f + cell * (static_cast<float>(row) + 0.5f));
+    transforms.set_scale(index, cell * 0.8f);
+    transforms.set_rotation(index, static_cast<float>(index % 64) * 0.0982f);
+
+    // cheap integer hash for a stable per instance tint
+    auto hash = index * 2654435761u;
+    hash ^= hash >> 15;
+    transforms.set_attributes(index, hash | 0xff000000u, index % 4);
+  }
+
+  return transforms;
+}
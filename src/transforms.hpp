@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "culling.hpp"
+#include "instances.hpp"
+
+// cpu side instance transforms stored as structure of arrays, batches of
+// consecutive instances are read with full width vector loads
+//
+// every change marks the instance's block dirty, write() turns runs of dirty
+// blocks into gpu instance records and bounds, straight into whatever mapped
+// memory the caller hands it
+class transform_system_t {
+public:
+  static constexpr uint32_t block_size = 64; // instances per dirty bit
+
+  // unit scale, no rotation, everything dirty
+  explicit transform_system_t(const uint32_t count);
+
+  uint32_t size() const { return count; }
+
+  void set_position(const uint32_t index, const float x, const float y);
+  void set_rotation(const uint32_t index, const float radians);
+  void set_scale(const uint32_t index, const float scale);
+  void set_attributes(const uint32_t index, const uint32_t color,
+                      const uint32_t material);
+
+  // spin [first, first + count) by radians
+  void rotate(const uint32_t first, const uint32_t count, const float radians);
+
+  // everything is written again, eg: bounds change with the mesh radius
+  void mark_all();
+
+  struct range_t {
+    uint32_t first = 0, count = 0; // instances
+  };
+
+  // first run of dirty blocks, cut to whole blocks of at most max_count
+  // instances, empty when nothing is dirty or no block fits
+  range_t next_dirty(const uint32_t max_count) const;
+
+  // instance records and bounds for a range of whole blocks, clears their
+  // dirty bits, outputs are written front to back and never read so they may
+  // be write combined
+  //
+  // disjoint ranges may be written from different threads at once, as long
+  // as nothing else changes the system meanwhile
+  void write(const range_t, const float mesh_radius, std::span<instance_t>,
+             std::span<instance_bounds_t>);
+
+private:
+  void mark(const uint32_t first, const uint32_t count);
+
+  uint32_t count = 0;
+
+  // padded to whole blocks
+  std::vector<float> x = {}, y = {};
+  std::vector<float> rotation = {}; // radians
+  std::vector<float> scale = {};    // uniform
+  std::vector<uint32_t> color = {}, material = {};
+
+  std::vector<uint64_t> dirty = {}; // one bit per block
+};
+
+// lay count instances out on a square grid covering the viewport
+transform_system_t create_instance_grid(const uint32_t count);
@@ -0,0 +1,493 @@
+#include <algorithm>
+#include <cstring>
+
+#include "globals.hpp"
+
+#include "upload.hpp"
+
+namespace {
+
+constexpr VkDeviceSize texel_size = 4;
+
+// a level's move from TRANSFER_DST to SHADER_READ_ONLY, both halves of an
+// ownership transfer use the same layouts
+VkImageMemoryBarrier level_barrier(VkImage image, const uint32_t level,
+                                   const uint32_t src_family,
+                                   const uint32_t dst_family) {
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = 0;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcQueueFamilyIndex = src_family;
+  barrier.dstQueueFamilyIndex = dst_family;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+  return barrier;
+}
+
+} // namespace
+
+upload_context_t::upload_context_t(VkDevice device, VkQueue queue,
+                                   const uint32_t queue_family_index,
+                                   const uint32_t dst_family_index,
+                                   const VkExtent3D image_granularity,
+                                   gpu_allocator_t &allocator,
+                                   const VkDeviceSize staging_size,
+                                   std::mutex *queue_lock)
+    : device{device}, queue{queue}, queue_lock{queue_lock},
+      src_family{queue_family_index},
+      dst_family{dst_family_index}, granularity{image_granularity},
+      allocator{allocator},
+      segment_size{staging_size / segment_count} {
+  {
+    VkSemaphoreTypeCreateInfo type_info = {};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    create_info.pNext = &type_info;
+    VK_CALL(vkCreateSemaphore(device, &create_info, nullptr, &semaphore));
+  }
+
+  {
+    VkCommandPoolCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    create_info.queueFamilyIndex = queue_family_index;
+    VK_CALL(vkCreateCommandPool(device, &create_info, nullptr, &cmd_pool));
+  }
+
+  {
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.size = segment_size * segment_count;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    staging_memory =
+        allocator.create_buffer(buffer_info, memory_usage_t::upload, staging);
+  }
+
+  std::array<VkCommandBuffer, segment_count> cmd_buffers = {};
+  {
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandPool = cmd_pool;
+    alloc_info.commandBufferCount = segment_count;
+    VK_CALL(vkAllocateCommandBuffers(device, &alloc_info, cmd_buffers.data()));
+  }
+
+  for (uint32_t index = 0; index < segment_count; index += 1) {
+    auto &segment = segments[index];
+    segment.cmd_buffer = cmd_buffers[index];
+    segment.offset = segment_size * index;
+  }
+}
+
+upload_context_t::~upload_context_t() {
+  wait_timeline(submitted);
+
+  vkDestroyCommandPool(device, cmd_pool, nullptr);
+  vkDestroySemaphore(device, semaphore, nullptr);
+  allocator.destroy_buffer(staging, staging_memory);
+}
+
+VkBuffer upload_context_t::create_buffer(const std::span<const std::byte> data,
+                                         const VkBufferUsageFlags usage,
+                                         gpu_allocation_t &allocation) {
+  VkBufferCreateInfo buffer_info = {};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  buffer_info.size = data.size();
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer buffer = {};
+  allocation =
+      allocator.create_buffer(buffer_info, memory_usage_t::gpu_only, buffer);
+
+  upload(buffer, 0, data);
+  return buffer;
+}
+
+void upload_context_t::upload(VkBuffer dst, VkDeviceSize dst_offset,
+                              std::span<const std::byte> data) {
+  std::unique_lock lock{mutex};
+
+  while (!data.empty()) {
+    auto &segment = open_segment(lock);
+    if (segment.used == segment_size) {
+      submit_segment(segment);
+      continue;
+    }
+
+    const auto size = std::min<VkDeviceSize>(segment_size - segment.used,
+                                             data.size());
+    const auto src_offset = segment.offset + segment.used;
+    std::memcpy(staging_memory.mapped + src_offset, data.data(), size);
+
+    segment.copies.push_back({dst, {src_offset, dst_offset, size}});
+    segment.used += size;
+
+    dst_offset += size;
+    data = data.subspan(size);
+  }
+}
+
+void upload_context_t::upload_image(VkImage dst, const uint32_t level,
+                                    const VkExtent2D extent,
+                                    std::span<const std::byte> data) {
+  std::unique_lock lock{mutex};
+
+  constexpr VkDeviceSize offset_alignment = 16;
+  const auto row_size = VkDeviceSize{extent.width} * texel_size;
+  const auto step = row_step(extent.height);
+  ASSERT(data.size() == row_size * extent.height);
+  ASSERT(fits_image(extent));
+
+  for (uint32_t row = 0; row < extent.height;) {
+    auto &segment = open_segment(lock);
+    const auto used =
+        (segment.used + offset_alignment - 1) & ~(offset_alignment - 1);
+    auto rows = static_cast<uint32_t>(std::min<VkDeviceSize>(
+        used < segment_size ? (segment_size - used) / row_size : 0,
+        extent.height - row));
+
+    // ranges start and end on the granularity, except at the level's end
+    if (row + rows != extent.height)
+      rows -= rows % step;
+
+    if (rows == 0) {
+      submit_segment(segment);
+      continue;
+    }
+
+    const auto size = rows * row_size;
+    const auto src_offset = segment.offset + used;
+    std::memcpy(staging_memory.mapped + src_offset,
+                data.data() + row * row_size, size);
+
+    image_copy_t copy = {};
+    copy.image = dst;
+    copy.region.bufferOffset = src_offset;
+    copy.region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+    copy.region.imageOffset = {0, static_cast<int32_t>(row), 0};
+    copy.region.imageExtent = {extent.width, rows, 1};
+    copy.first = row == 0;
+    copy.last = row + rows == extent.height;
+    segment.image_copies.push_back(copy);
+    segment.used = used + size;
+
+    row += rows;
+  }
+}
+
+bool upload_context_t::fits_image(const VkExtent2D extent) const {
+  const auto row_size = VkDeviceSize{extent.width} * texel_size;
+  return row_size * row_step(extent.height) <= segment_size;
+}
+
+upload_ticket_t upload_context_t::flush(std::span<const VkBuffer> finished) {
+  std::unique_lock lock{mutex};
+
+  if (!segments[current].copies.empty() ||
+      !segments[current].image_copies.empty() || !finished.empty())
+    submit_segment(open_segment(lock), finished);
+
+  return submitted;
+}
+
+bool upload_context_t::complete(const upload_ticket_t ticket) {
+  const std::scoped_lock lock{mutex};
+
+  if (ticket > completed) {
+    for (auto &segment : segments)
+      retire(segment);
+  }
+
+  return ticket <= completed;
+}
+
+void upload_context_t::wait(const upload_ticket_t ticket) {
+  {
+    const std::scoped_lock lock{mutex};
+    ASSERT(ticket <= submitted);
+    if (ticket <= completed)
+      return;
+  }
+
+  // other threads keep uploading and acquiring meanwhile
+  wait_timeline(ticket);
+
+  const std::scoped_lock lock{mutex};
+  for (auto &segment : segments)
+    retire(segment);
+}
+
+upload_ticket_t upload_context_t::acquire(VkCommandBuffer cmd_buffer) {
+  const std::scoped_lock lock{mutex};
+
+  // frames only wait for the batches holding what they take over, not for
+  // unrelated copies still in flight
+  upload_ticket_t ticket = 0;
+  if (!released.empty() || !released_levels.empty()) {
+    std::vector<VkBufferMemoryBarrier> barriers{released.size()};
+    for (size_t index = 0; index < released.size(); index += 1) {
+      auto &barrier = barriers[index];
+      barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+      barrier.srcQueueFamilyIndex = src_family;
+      barrier.dstQueueFamilyIndex = dst_family;
+      barrier.buffer = released[index].buffer;
+      barrier.offset = 0;
+      barrier.size = VK_WHOLE_SIZE;
+      ticket = std::max(ticket, released[index].ticket);
+    }
+
+    // must repeat the layout transition of the release
+    std::vector<VkImageMemoryBarrier> image_barriers{released_levels.size()};
+    for (size_t index = 0; index < released_levels.size(); index += 1) {
+      const auto &[image, level, released_by] = released_levels[index];
+      image_barriers[index] = level_barrier(image, level, src_family,
+                                            dst_family);
+      image_barriers[index].srcAccessMask = 0;
+      image_barriers[index].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      ticket = std::max(ticket, released_by);
+    }
+
+    // the submission waits on the timeline at all commands, which this
+    // barrier chains onto
+    vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()),
+                         barriers.data(),
+                         static_cast<uint32_t>(image_barriers.size()),
+                         image_barriers.data());
+    released.clear();
+    released_levels.clear();
+  }
+
+  return ticket;
+}
+
+uint32_t upload_context_t::row_step(const uint32_t height) const {
+  return granularity.height == 0 ? height
+                                 : std::min(granularity.height, height);
+}
+
+upload_context_t::segment_t &
+upload_context_t::open_segment(std::unique_lock<std::mutex> &lock) {
+  // the ring wrapped around, wait for the batch still reading this segment,
+  // without the lock so acquire() and complete() are not held up by it
+  while (true) {
+    auto &segment = segments[current];
+    retire(segment);
+    if (!segment.in_flight)
+      return segment;
+
+    const auto ticket = segment.ticket;
+    lock.unlock();
+    wait_timeline(ticket);
+    lock.lock();
+  }
+}
+
+void upload_context_t::submit_segment(segment_t &segment,
+                                      std::span<const VkBuffer> release) {
+  if (segment.copies.empty() && segment.image_copies.empty() &&
+      release.empty())
+    return;
+
+  flush_allocation(device, staging_memory);
+
+  // what this batch releases is only usable once it completes
+  const auto ticket = submitted + 1;
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  VK_CALL(vkResetCommandBuffer(segment.cmd_buffer, 0));
+  VK_CALL(vkBeginCommandBuffer(segment.cmd_buffer, &begin_info));
+
+  // one copy command per destination buffer
+  {
+    auto &copies = segment.copies;
+    std::stable_sort(copies.begin(), copies.end(),
+                     [](const auto &a, const auto &b) {
+                       return std::less<VkBuffer>{}(a.first, b.first);
+                     });
+
+    std::vector<VkBufferCopy> regions = {};
+    for (auto first = copies.begin(); first != copies.end();) {
+      const auto last =
+          std::find_if(first, copies.end(), [&](const auto &copy) {
+            return copy.first != first->first;
+          });
+
+      regions.clear();
+      for (auto copy = first; copy != last; copy++)
+        regions.push_back(copy->second);
+
+      vkCmdCopyBuffer(segment.cmd_buffer, staging, first->first,
+                      static_cast<uint32_t>(regions.size()), regions.data());
+      first = last;
+    }
+  }
+
+  // levels leave UNDEFINED before their first rows are copied and are done
+  // with once their last rows are, or released to the consumer family
+  if (!segment.image_copies.empty()) {
+    std::vector<VkImageMemoryBarrier> barriers = {};
+    for (const auto &copy : segment.image_copies) {
+      if (!copy.first)
+        continue;
+
+      auto barrier = level_barrier(copy.image,
+                                   copy.region.imageSubresource.mipLevel,
+                                   VK_QUEUE_FAMILY_IGNORED,
+                                   VK_QUEUE_FAMILY_IGNORED);
+      barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barriers.push_back(barrier);
+    }
+
+    // clang-format off
+    if (!barriers.empty())
+      vkCmdPipelineBarrier(segment.cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    for (const auto &copy : segment.image_copies)
+      vkCmdCopyBufferToImage(segment.cmd_buffer, staging, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+    // clang-format on
+
+    barriers.clear();
+    for (const auto &copy : segment.image_copies) {
+      if (!copy.last)
+        continue;
+
+      const auto level = copy.region.imageSubresource.mipLevel;
+      const auto transfer = src_family != dst_family;
+      barriers.push_back(level_barrier(
+          copy.image, level, transfer ? src_family : VK_QUEUE_FAMILY_IGNORED,
+          transfer ? dst_family : VK_QUEUE_FAMILY_IGNORED));
+
+      if (transfer)
+        released_levels.push_back({copy.image, level, ticket});
+      else
+        barriers.back().dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    // clang-format off
+    if (!barriers.empty())
+      vkCmdPipelineBarrier(segment.cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+    // clang-format on
+  }
+
+  // hand the finished buffers to the consumer family, the barrier also
+  // covers copies submitted in earlier batches
+  if (src_family != dst_family) {
+    if (!release.empty()) {
+      std::vector<VkBufferMemoryBarrier> barriers{release.size()};
+      for (size_t index = 0; index < release.size(); index += 1) {
+        auto &barrier = barriers[index];
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = src_family;
+        barrier.dstQueueFamilyIndex = dst_family;
+        barrier.buffer = release[index];
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        // released again before an acquire, the newer batch covers both
+        const auto found =
+            std::find_if(released.begin(), released.end(),
+                         [&](const auto &entry) {
+                           return entry.buffer == release[index];
+                         });
+        if (found != released.end())
+          found->ticket = ticket;
+        else
+          released.push_back({release[index], ticket});
+      }
+
+      vkCmdPipelineBarrier(segment.cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                           static_cast<uint32_t>(barriers.size()),
+                           barriers.data(), 0, nullptr);
+    }
+  }
+
+  // later submissions on this queue may read the data from any stage
+  else {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+    vkCmdPipelineBarrier(segment.cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+  }
+
+  VK_CALL(vkEndCommandBuffer(segment.cmd_buffer));
+
+  submitted = ticket;
+
+  VkSemaphoreSubmitInfo signal_info = {};
+  signal_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+  signal_info.semaphore = semaphore;
+  signal_info.value = submitted;
+  signal_info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+  VkCommandBufferSubmitInfo cmd_info = {};
+  cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+  cmd_info.commandBuffer = segment.cmd_buffer;
+
+  VkSubmitInfo2 submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+  submit_info.commandBufferInfoCount = 1;
+  submit_info.pCommandBufferInfos = &cmd_info;
+  submit_info.signalSemaphoreInfoCount = 1;
+  submit_info.pSignalSemaphoreInfos = &signal_info;
+  {
+    auto queue_guard = queue_lock ? std::unique_lock{*queue_lock}
+                                  : std::unique_lock<std::mutex>{};
+    VK_CALL(vkQueueSubmit2(queue, 1, &submit_info, VK_NULL_HANDLE));
+  }
+
+  segment.ticket = submitted;
+  segment.in_flight = true;
+  segment.copies.clear();
+  segment.image_copies.clear();
+
+  current = (current + 1) % segment_count;
+}
+
+void upload_context_t::retire(segment_t &segment) {
+  if (segment.in_flight && segment.ticket > completed)
+    VK_CALL(vkGetSemaphoreCounterValue(device, semaphore, &completed));
+
+  // batches complete in order, the timeline covers every earlier one
+  if (segment.in_flight && segment.ticket <= completed) {
+    segment.in_flight = false;
+    segment.used = 0;
+  }
+}
+
+void upload_context_t::wait_timeline(const upload_ticket_t ticket) const {
+  VkSemaphoreWaitInfo wait_info = {};
+  wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  wait_info.semaphoreCount = 1;
+  wait_info.pSemaphores = &semaphore;
+  wait_info.pValues = &ticket;
+  VK_CALL(vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+}
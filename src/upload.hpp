@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.hpp"
+
+// identifies a submitted batch of copies, tickets increase monotonically so
+// waiting on one covers every earlier batch
+using upload_ticket_t = uint64_t;
+
+// copies host data into device local buffers through a persistently mapped
+// staging ring, the ring is split into segments that each back one batch of
+// copies and are reused once the timeline reaches their previous batch
+//
+// when the copies run on the queue that consumes the data they end in a full
+// memory barrier; on a dedicated transfer queue the buffers a flush() is
+// given are released to the consumer family by it instead, which must record
+// acquire() and wait on the timeline before using them
+//
+// images are uploaded one mip level at a time and each level moves to
+// SHADER_READ_ONLY_OPTIMAL as its last copy completes, released to the
+// consumer family on its own; levels are split into row ranges aligned to the
+// queue's image transfer granularity, or kept whole when it is (0,0,0)
+//
+// upload() and flush() may be called from any thread, queue_lock is held
+// around submits when other threads submit to the same queue
+class upload_context_t {
+public:
+  static constexpr VkDeviceSize default_staging_size = VkDeviceSize{16} << 20;
+  static constexpr uint32_t segment_count = 4;
+
+  upload_context_t(VkDevice, VkQueue, const uint32_t queue_family_index,
+                   const uint32_t dst_family_index,
+                   const VkExtent3D image_granularity, gpu_allocator_t &,
+                   const VkDeviceSize staging_size = default_staging_size,
+                   std::mutex *queue_lock = nullptr);
+  ~upload_context_t();
+
+  upload_context_t(const upload_context_t &) = delete;
+  upload_context_t &operator=(const upload_context_t &) = delete;
+
+  // device local buffer with TRANSFER_DST added to usage, the contents are
+  // queued for upload and land once the returned buffer's batch is flushed
+  VkBuffer create_buffer(const std::span<const std::byte>,
+                         const VkBufferUsageFlags, gpu_allocation_t &);
+
+  // queue a copy into dst, data is staged immediately and may be reused by the
+  // caller, large copies are split across segments
+  //
+  // with a dedicated transfer queue dst must not be used by the consumer
+  // family between its last acquire and the next flush() given it
+  void upload(VkBuffer dst, const VkDeviceSize dst_offset,
+              std::span<const std::byte>);
+
+  // queue a copy of tightly packed 4 byte texels into one level of a single
+  // layer color image, whatever the level held before is discarded, large
+  // levels are split by rows across segments
+  //
+  // the level must not be accessed until the consumer's acquire() of a flush
+  // submitted after this call
+  void upload_image(VkImage dst, const uint32_t level, const VkExtent2D,
+                    std::span<const std::byte>);
+
+  // whether upload_image() can stage a level of this size, the smallest row
+  // range the granularity allows must fit one segment
+  bool fits_image(const VkExtent2D) const;
+
+  // submit everything queued so far and hand over the finished buffers and
+  // every completed image level, returns the ticket of the last batch
+  //
+  // buffers other threads are still writing stay with the transfer family,
+  // so each caller lists only the buffers it has queued every copy into
+  upload_ticket_t flush(std::span<const VkBuffer> finished = {});
+
+  bool complete(const upload_ticket_t);
+  void wait(const upload_ticket_t);
+
+  // signaled with each batch's ticket once its copies have completed
+  VkSemaphore timeline() const { return semaphore; }
+
+  // record the consumer side of the ownership transfers of every batch
+  // flushed so far, returns the ticket of the newest batch that released
+  // something acquired here, or 0 when the submission need not wait
+  upload_ticket_t acquire(VkCommandBuffer);
+
+private:
+  // rows of one image level, the first copy of a level moves it out of
+  // UNDEFINED and the last one into SHADER_READ_ONLY_OPTIMAL
+  struct image_copy_t {
+    VkImage image = {};
+    VkBufferImageCopy region = {};
+    bool first = false, last = false;
+  };
+
+  // handed to the consumer family by the batch of ticket, waiting for its
+  // acquire
+  struct released_buffer_t {
+    VkBuffer buffer = {};
+    upload_ticket_t ticket = 0;
+  };
+
+  struct released_level_t {
+    VkImage image = {};
+    uint32_t level = 0;
+    upload_ticket_t ticket = 0;
+  };
+
+  struct segment_t {
+    VkCommandBuffer cmd_buffer = {};
+    VkDeviceSize offset = 0; // start within the staging buffer
+    VkDeviceSize used = 0;
+    upload_ticket_t ticket = 0; // batch last submitted from this segment
+    bool in_flight = false;
+    std::vector<std::pair<VkBuffer, VkBufferCopy>> copies = {};
+    std::vector<image_copy_t> image_copies = {};
+  };
+
+  // rows of a level that must be copied together
+  uint32_t row_step(const uint32_t height) const;
+
+  // waits for the segment's previous batch with the lock released
+  segment_t &open_segment(std::unique_lock<std::mutex> &);
+  void submit_segment(segment_t &, std::span<const VkBuffer> release = {});
+  void retire(segment_t &);
+  void wait_timeline(const upload_ticket_t) const;
+
+  VkDevice device;
+  VkQueue queue;
+  std::mutex *queue_lock;
+  const uint32_t src_family, dst_family;
+  const VkExtent3D granularity;
+  gpu_allocator_t &allocator;
+
+  VkSemaphore semaphore = {};
+  VkCommandPool cmd_pool = {};
+  VkBuffer staging = {};
+  gpu_allocation_t staging_memory = {};
+  VkDeviceSize segment_size = 0;
+
+  std::mutex mutex;
+  std::array<segment_t, segment_count> segments = {};
+  uint32_t current = 0;
+  upload_ticket_t submitted = 0;
+  upload_ticket_t completed = 0;
+  std::vector<released_buffer_t> released = {};
+  std::vector<released_level_t> released_levels = {};
+};
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mesh_format.hpp"
+
+// converts a wavefront .obj into a .cmesh, the renderer is 2d so only the xy
+// positions are kept, faces are fan triangulated and the mesh is centered and
+// scaled to fit the unit quad instances are drawn in
+//
+//   obj_to_cmesh input.obj output.cmesh
+namespace {
+struct mesh_t {
+  std::vector<float> positions = {}; // xy pairs
+  std::vector<uint32_t> indices = {};
+};
+
+// obj indices are 1 based, negative ones count back from the last vertex
+bool parse_index(std::string_view token, const size_t vertex_count,
+                 uint32_t &index) {
+  // v, v/vt, v//vn, v/vt/vn
+  token = token.substr(0, token.find('/'));
+
+  int64_t value = 0;
+  const auto [end, error] =
+      std::from_chars(token.data(), token.data() + token.size(), value);
+  if (error != std::errc{} || end != token.data() + token.size() || value == 0)
+    return false;
+
+  const auto resolved = value > 0 ? value - 1
+                                  : static_cast<int64_t>(vertex_count) + value;
+  if (resolved < 0 || resolved >= static_cast<int64_t>(vertex_count))
+    return false;
+
+  index = static_cast<uint32_t>(resolved);
+  return true;
+}
+
+bool parse_obj(std::istream &input, mesh_t &mesh) {
+  std::string line;
+  std::vector<uint32_t> face;
+
+  for (uint64_t line_number = 1; std::getline(input, line); line_number += 1) {
+    std::istringstream tokens{line};
+    std::string keyword;
+    tokens >> keyword;
+
+    if (keyword == "v") {
+      float x = 0.0f, y = 0.0f;
+      if (!(tokens >> x >> y)) {
+        std::cerr << "line " << line_number << ": bad vertex" << std::endl;
+        return false;
+      }
+
+      mesh.positions.push_back(x);
+      mesh.positions.push_back(y);
+    } else if (keyword == "f") {
+      face.clear();
+      const auto vertex_count = mesh.positions.size() / 2;
+
+      std::string token;
+      while (tokens >> token) {
+        uint32_t index = 0;
+        if (!parse_index(token, vertex_count, index)) {
+          std::cerr << "line " << line_number << ": bad face index " << token
+                    << std::endl;
+          return false;
+        }
+
+        face.push_back(index);
+      }
+
+      for (size_t corner = 2; corner < face.size(); corner += 1) {
+        mesh.indices.push_back(face[0]);
+        mesh.indices.push_back(face[corner - 1]);
+        mesh.indices.push_back(face[corner]);
+      }
+    }
+  }
+
+  if (mesh.indices.empty()) {
+    std::cerr << "no faces" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// center on the bounding box and scale the farthest vertex to 0.5
+float normalize(mesh_t &mesh) {
+  float min[2] = {INFINITY, INFINITY}, max[2] = {-INFINITY, -INFINITY};
+  for (size_t index = 0; index < mesh.positions.size(); index += 1) {
+    min[index % 2] = std::min(min[index % 2], mesh.positions[index]);
+    max[index % 2] = std::max(max[index % 2], mesh.positions[index]);
+  }
+
+  const float center[2] = {(min[0] + max[0]) / 2, (min[1] + max[1]) / 2};
+  float radius = 0.0f;
+  for (size_t index = 0; index < mesh.positions.size(); index += 2) {
+    const auto x = mesh.positions[index] - center[0];
+    const auto y = mesh.positions[index + 1] - center[1];
+    radius = std::max(radius, std::sqrt(x * x + y * y));
+  }
+
+  const auto scale = radius > 0.0f ? 0.5f / radius : 1.0f;
+  for (size_t index = 0; index < mesh.positions.size(); index += 1)
+    mesh.positions[index] = (mesh.positions[index] - center[index % 2]) * scale;
+
+  return radius > 0.0f ? 0.5f : 0.0f;
+}
+
+template <typename T>
+void write_padded(std::ostream &output, const T *data, const uint64_t size) {
+  output.write(reinterpret_cast<const char *>(data),
+               static_cast<std::streamsize>(size));
+
+  const uint64_t padding = cmesh_align(size) - size;
+  const char zeros[cmesh_alignment] = {};
+  output.write(zeros, static_cast<std::streamsize>(padding));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " input.obj output.cmesh"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream input{argv[1]};
+  if (!input) {
+    std::cerr << "unable to open " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  mesh_t mesh;
+  if (!parse_obj(input, mesh))
+    return EXIT_FAILURE;
+
+  cmesh_header_t header = {};
+  header.vertex_stride = 2 * sizeof(float);
+  header.vertex_count = mesh.positions.size() / 2;
+  header.index_count = mesh.indices.size();
+  header.index_size = header.vertex_count <= UINT16_MAX + 1u ? 2 : 4;
+  header.vertex_offset = cmesh_align(sizeof(cmesh_header_t));
+  header.index_offset = header.vertex_offset +
+                        cmesh_align(header.vertex_count * header.vertex_stride);
+  header.radius = normalize(mesh);
+
+  std::ofstream output{argv[2], std::ios::binary};
+  if (!output) {
+    std::cerr << "unable to open " << argv[2] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  write_padded(output, &header, sizeof(header));
+  write_padded(output, mesh.positions.data(),
+               header.vertex_count * header.vertex_stride);
+
+  if (header.index_size == 2) {
+    std::vector<uint16_t> narrow(mesh.indices.begin(), mesh.indices.end());
+    write_padded(output, narrow.data(), narrow.size() * sizeof(uint16_t));
+  } else {
+    write_padded(output, mesh.indices.data(),
+                 mesh.indices.size() * sizeof(uint32_t));
+  }
+
+  if (!output) {
+    std::cerr << "unable to write " << argv[2] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << argv[2] << ": " << header.vertex_count << " vertices, "
+            << header.index_count / 3 << " triangles" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "texture_format.hpp"
+
+// converts a binary .ppm into a .ctex with its full mip chain, each level is
+// a 2x2 box filter of the one above, 3 wide on odd edges, averaged in linear
+// space
+//
+//   ppm_to_ctex input.ppm output.ctex
+namespace {
+struct level_t {
+  uint32_t width = 0, height = 0;
+  std::vector<uint8_t> texels = {}; // srgb rgba8
+};
+
+// the next header token, skipping whitespace and comments
+bool read_token(std::istream &input, std::string &token) {
+  token.clear();
+  for (int c = input.get(); c != EOF; c = input.get()) {
+    if (c == '#') {
+      while (c != EOF && c != '\n')
+        c = input.get();
+    } else if (std::isspace(c)) {
+      if (!token.empty())
+        return true;
+    } else {
+      token.push_back(static_cast<char>(c));
+    }
+  }
+
+  return !token.empty();
+}
+
+bool parse_dimension(const std::string &token, uint32_t &out) {
+  const auto [end, error] =
+      std::from_chars(token.data(), token.data() + token.size(), out);
+  return error == std::errc{} && end == token.data() + token.size();
+}
+
+bool read_ppm(std::istream &input, level_t &level) {
+  std::string magic, width, height, max_value;
+  if (!read_token(input, magic) || magic != "P6" ||
+      !read_token(input, width) || !read_token(input, height) ||
+      !read_token(input, max_value) || max_value != "255" ||
+      !parse_dimension(width, level.width) ||
+      !parse_dimension(height, level.height)) {
+    std::cerr << "not an 8 bit binary ppm" << std::endl;
+    return false;
+  }
+
+  if (level.width == 0 || level.height == 0) {
+    std::cerr << "empty image" << std::endl;
+    return false;
+  }
+
+  std::vector<uint8_t> rgb(size_t{level.width} * level.height * 3);
+  if (!input.read(reinterpret_cast<char *>(rgb.data()),
+                  static_cast<std::streamsize>(rgb.size()))) {
+    std::cerr << "truncated" << std::endl;
+    return false;
+  }
+
+  level.texels.resize(size_t{level.width} * level.height * 4);
+  for (size_t texel = 0; texel < rgb.size() / 3; texel += 1) {
+    std::copy_n(&rgb[texel * 3], 3, &level.texels[texel * 4]);
+    level.texels[texel * 4 + 3] = 255;
+  }
+
+  return true;
+}
+
+float to_linear(const uint8_t value) {
+  const auto c = value / 255.0f;
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t to_srgb(const float value) {
+  const auto c = value <= 0.0031308f
+                     ? value * 12.92f
+                     : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+  return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// the source rows or columns a texel of the next level averages, a pair, or
+// the last three when the source is odd so its final row or column is kept
+std::pair<uint32_t, uint32_t> footprint(const uint32_t index,
+                                        const uint32_t count,
+                                        const uint32_t source) {
+  const auto last = index + 1 == count && source % 2 == 1;
+  return {index * 2, last ? source : std::min(index * 2 + 2, source)};
+}
+
+level_t downsample(const level_t &source) {
+  level_t level = {};
+  level.width = std::max(source.width / 2, 1u);
+  level.height = std::max(source.height / 2, 1u);
+  level.texels.resize(size_t{level.width} * level.height * 4);
+
+  for (uint32_t y = 0; y < level.height; y += 1) {
+    const auto [y0, y1] = footprint(y, level.height, source.height);
+    for (uint32_t x = 0; x < level.width; x += 1) {
+      const auto [x0, x1] = footprint(x, level.width, source.width);
+      const auto samples = static_cast<float>((x1 - x0) * (y1 - y0));
+
+      for (uint32_t channel = 0; channel < 4; channel += 1) {
+        float sum = 0.0f;
+        for (uint32_t sy = y0; sy < y1; sy += 1) {
+          for (uint32_t sx = x0; sx < x1; sx += 1) {
+            const auto value =
+                source.texels[(size_t{sy} * source.width + sx) * 4 + channel];
+            sum += channel == 3 ? value / 255.0f : to_linear(value);
+          }
+        }
+
+        const auto average = sum / samples;
+        level.texels[(size_t{y} * level.width + x) * 4 + channel] =
+            channel == 3 ? static_cast<uint8_t>(average * 255.0f + 0.5f)
+                         : to_srgb(average);
+      }
+    }
+  }
+
+  return level;
+}
+
+void write_padded(std::ostream &output, const void *data, const uint64_t size) {
+  output.write(static_cast<const char *>(data),
+               static_cast<std::streamsize>(size));
+
+  const uint64_t padding = ctex_align(size) - size;
+  const char zeros[ctex_alignment] = {};
+  output.write(zeros, static_cast<std::streamsize>(padding));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " input.ppm output.ctex"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream input{argv[1], std::ios::binary};
+  if (!input) {
+    std::cerr << "unable to open " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<level_t> levels(1);
+  if (!read_ppm(input, levels[0]))
+    return EXIT_FAILURE;
+
+  // the chain has bit_width levels, checked before any of it is built
+  if (std::bit_width(std::max(levels[0].width, levels[0].height)) >
+      ctex_max_levels) {
+    std::cerr << "too large" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  while (levels.back().width > 1 || levels.back().height > 1)
+    levels.push_back(downsample(levels.back()));
+
+  ctex_header_t header = {};
+  header.width = levels[0].width;
+  header.height = levels[0].height;
+  header.level_count = static_cast<uint32_t>(levels.size());
+
+  // smallest level first
+  std::vector<ctex_level_t> table(levels.size());
+  auto offset =
+      ctex_align(sizeof(ctex_header_t) + table.size() * sizeof(ctex_level_t));
+  for (auto index = levels.size(); index-- > 0;) {
+    table[index] = {levels[index].width, levels[index].height, offset};
+    offset += ctex_align(levels[index].texels.size());
+  }
+
+  std::ofstream output{argv[2], std::ios::binary};
+  if (!output) {
+    std::cerr << "unable to open " << argv[2] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  write_padded(output, table.data(), table.size() * sizeof(ctex_level_t));
+  for (auto index = levels.size(); index-- > 0;)
+    write_padded(output, levels[index].texels.data(),
+                 levels[index].texels.size());
+
+  if (!output) {
+    std::cerr << "unable to write " << argv[2] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << argv[2] << ": " << header.width << "x" << header.height << ", "
+            << header.level_count << " levels" << std::endl;
+  return EXIT_SUCCESS;
+}